@@ -6,25 +6,26 @@
 */
 
 #include "yaml-cpp/yaml.h"
+#include "libautomega.h"
 
 #include <iostream>
-#include <fstream>
-#include <iomanip>
+#include <sstream>
 #include <atomic>
 #include <mutex>
 #include <string>
 #include <vector>
-#include <regex>
+#include <set>
 #include <thread>
-#include <ctime>
-#include <chrono>
-#include <algorithm>
+#include <climits>
+#include <cerrno>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <libgen.h>
+#include <fcntl.h>
 #include <termios.h>
-#include <sys/statvfs.h>
-#include <glob.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 using namespace std;
 
@@ -34,201 +35,65 @@ using namespace std;
 namespace backward {backward::SignalHandling sh;}
 #endif
 
-// Default values for all arguments. Strings cannot be atomic, but they should only be read by threads, so there shouldnt be a problem.
-
-/// Yaml config file for the simulation
-string settings = "config.yaml";
-/// Revan settings file (defaults to revan default)
-string revanSettings = "~/.revan.cfg";
-/// Slack hook (if empty, slack notifications are disabled)
-string token = "";
-/// Slack channel
-string channel = "";
-/// Email address for notifications (if empty, email notifications are disabled)
-string address = "";
-/// Maximum threads to use for simulations (defaults to system thread count)
-int maxThreads = (std::thread::hardware_concurrency()==0)?4:std::thread::hardware_concurrency(); // If it cannot detect the number of threads, default to 4
-/// Legend file
-ofstream legend;
-/// Mutex to make sure only one thing is writing to legend at a time
-mutex legendLock;
-/// Current thread count
-atomic<int> currentThreadCount(0);
-/// Int to indicate test level (0=real run, otherwise it disables some exiting or notification features)
-atomic<int> test(0);
-/// Bool to indicate what files to keep (false = keep no intermediary files, true = keep all)
-atomic<bool> keepAll(false);
-/// Int to indicate slack verbosity level. Level 3 prints all messages, level 2 prints fewer messages, level one prints only error messages, and level zero only prints final messages. Defaults to zero
-atomic<int> slackVerbosity(0);
-/// Int to indicate cosima verbosity level. Defaults to zero
-atomic<int> cosimaVerbosity(0);
-/// Array to store current state for status bar
-atomic<int> statusBar[9];
-/// Running average of simulation length
-chrono::seconds averageTime(0);
-/// semaphore for average time
-mutex timeLock;
-/// Bool to tell external threads to exit
-std::atomic<bool> exitFlag;
-
-
-/**
- @brief Generates a random seed from /dev/random or /dev/urandom
-
- ## Generate a random seed from /dev/random or /dev/urandom
-
- Generating the seed from /dev/random (or even /dev/urandom) is prefered to generating the seed from the current time because it allows you to start more than one simulation in a second and because /dev/random and /dev/urandom are more random than the current time, and /dev/random is cryptographically secure.
-
- ### Arguments
- * `bool uRandom` - Use /dev/urandom instead of /dev/random. Defaults to /dev/random
-
- Code adapted from that posted by `posop` on stackoverflow
-*/
-template<typename T>
-T random_seed(bool uRandom=0){
-    T seed;
-    std::ifstream file(uRandom?"/dev/urandom":"/dev/random",std::ios::binary);
-    if(file.is_open()){
-        char *memblock;
-        T size=sizeof(T);
-        memblock=new char [size];
-        file.read(memblock,size);
-        file.close();
-        seed=*reinterpret_cast<T*>(memblock);
-        delete[] memblock;
-        return seed;
-    }else{return random_seed<T>();} // Continually retry until /dev/random is free
-}
-
-
-/**
- @brief Removes a file, after expanding wildcards
-
- ## Removes a file, after expanding wildcards
-
- ### Arguments
- - `string file` - File to remove, may include
-
- ### Notes:
- Uses POSIX remove and glob
-
-*/
-void removeWildcard(std::string file){
-    glob_t glob_result;
-    glob(file.c_str(),GLOB_TILDE,NULL,&glob_result);
-    for(unsigned int i=0;i<glob_result.gl_pathc;++i) remove(glob_result.gl_pathv[i]);
-    globfree(&glob_result);
-}
-
-
 /**
-@brief Check if directory is empty
+ @brief Campaign run by the daemon
 
-  ## Check run directory for files
+ ## Campaign run by the daemon
 
-  ### Arguments:
-  * `string dir` - Directory to check if running in.
-
-  ### Notes:
-  If it is, it returns zero, otherwise it prompts the user for how they want to procede. Returns 0 if they want to procede and 1 otherwise.
+ ### Notes
+ Every campaign runs as its own autoMEGA process, in its own directory. The daemon polls it through its control socket, and sets its number of threads to its share of the node. Protected by `campaignLock`.
 */
-bool directoryEmpty(std::string dir){
-    int i, ret=system(("DIR='"+dir+"';[ \"$(ls -A $DIR)\" ] && exit 1 || exit 0").c_str());
-    i=WEXITSTATUS(ret); // Get return value.
-    if(i==0) return 0;
-    while(1){
-        std::cout << "Directory not empty. Press c then enter to clean, press s then enter to skip, or press e then enter to exit." << std::endl;
-        std::string input;
-        std::cin >> input;
-        if(input[0]=='c'||input[0]=='C'){
-            std::cout << "Cleaning directory." << std::endl;
-            removeWildcard(dir+"/*");
-            return 0;
-        }
-        if(input[0]=='s'||input[0]=='S'){
-            std::cout << "Skipping clean directory." << std::endl;
-            return 0;
-        }
-        if(input[0]=='e'||input[0]=='E'){
-            std::cout << "Exiting." << std::endl;
-            return 1;
-        }
-        std::cout << "Error. ";
-    }
-}
+struct daemonCampaign {
+    /// Campaign number, in order of submission
+    int id = 0;
+    /// Name shown in the status line (defaults to the name of the campaign directory)
+    string legend;
+    /// Settings file and campaign directory (absolute paths)
+    string settings, directory;
+    /// What to do with files already in the campaign directory ("skip" or "clean")
+    string existing = "skip";
+    /// Share of the node, relative to the other campaigns of the same priority
+    double weight = 1;
+    /// Priority class: every job of a higher class is started before any of a lower class
+    int priority = 0;
+    /// Process running the campaign (0 once it exited)
+    pid_t pid = 0;
+    /// Threads allocated to the campaign, and last number sent to it (0 while it is paused)
+    int allocated = 0, sent = -1;
+    /// Jobs running and waiting, as last reported by the campaign
+    int running = 0, waiting = INT_MAX/2;
+    /// Runs done and total, as last reported by the campaign
+    int done = 0, total = 0;
+    /// Return code of the campaign (-1 while it runs)
+    int exit = -1;
+};
+
+
+/// Bool set while jobs are paused (SIGUSR1 pauses, SIGUSR2 continues), forwarded to the campaign
+atomic<bool> paused(false);
+/// Bool set on SIGINT or SIGTERM, to cancel the campaign (or every campaign of the daemon)
+atomic<bool> interrupted(false);
+/// Bool to tell the control socket of the daemon to close
+std::atomic<bool> exitFlag(false);
+/// Campaigns submitted to the daemon
+vector<daemonCampaign> campaigns;
+/// Mutex to protect campaigns
+mutex campaignLock;
+/// Threads shared by every campaign of the daemon
+atomic<int> daemonThreads((std::thread::hardware_concurrency()==0)?4:std::thread::hardware_concurrency()); // If it cannot detect the number of threads, default to 4
+/// Bool set once the daemon was asked to drain every campaign and exit
+atomic<bool> daemonShutdown(false);
 
 
 /**
-@brief Storage watchdog program (threadable)
-
- ## Watches the amount of available storage, and kills the program if <n MB is remaining (configurable).
-
- ### Arguments:
- * `double MB` - Remaining storage (in MB) to abort if reached.
-
- ### Notes:
- Sleeps 1 second between tests.
-**/
-void storageWatchdog(double MB){
-    struct statvfs buf;
-    char pwd[1024];
-    getcwd(pwd, sizeof(pwd));
+ @brief Make a path absolute
 
-    while(!exitFlag){
-        statvfs(pwd, &buf);
-        if((buf.f_frsize * buf.f_bavail / 1000000) < MB) abort();
-        sleep(1);
-    }
-}
-
-
-/**
- @brief Returns a human-readable string of a duration.
-
-    ## Returns a human-readable string of a duration. Credit to TankorSmash on Stackoverflow for the code provided freely in answer to a question asked by sorush-r
-
-    ### Arguments:
-    * `std::chrono::seconds input_seconds` - Duration to convert to human readable string.
-
-    ### Returns:
-    * `std::string` - Human readable time duration.
+ ## Make a path absolute, relative to the current working directory
 */
-std::string beautify_duration(std::chrono::seconds input_seconds)
-{
-    using namespace std::chrono;
-    typedef duration<int, std::ratio<86400>> days;
-    auto d = duration_cast<days>(input_seconds);
-    input_seconds -= d;
-    auto h = duration_cast<hours>(input_seconds);
-    input_seconds -= h;
-    auto m = duration_cast<minutes>(input_seconds);
-    input_seconds -= m;
-    auto s = duration_cast<seconds>(input_seconds);
-
-    auto dc = d.count();
-    auto hc = h.count();
-    auto mc = m.count();
-    auto sc = s.count();
-
-    std::stringstream ss;
-    ss.fill('0');
-    if (dc) {
-        ss << d.count() << "d";
-    }
-    if (dc || hc) {
-        if (dc) { ss << std::setw(2); } //pad if second set of numbers
-        ss << h.count() << "h";
-    }
-    if (dc || hc || mc) {
-        if (dc || hc) { ss << std::setw(2); }
-        ss << m.count() << "m";
-    }
-    if (dc || hc || mc || sc) {
-        if (dc || hc || mc) { ss << std::setw(2); }
-        ss << s.count() << 's';
-    }
-
-    return ss.str();
+string absolutePath(string path){
+    if(!path.empty() && path[0]=='/') return path;
+    char pwd[PATH_MAX];
+    return (getcwd(pwd,sizeof(pwd))!=NULL)?string(pwd)+"/"+path:path;
 }
 
 
@@ -246,599 +111,401 @@ inline bool fileExists(const std::string& name){
 
 
 /**
- @brief Post message as slack bot, rather than with webhook
-
- ## Sends slack message
-
- ### Arguments:
- * `string token` - Bot oath2 token to use
- * `string channel` - Channel to post to (Bot must have access to this channel)
- * `string message` - Message to post
+ @brief Create a directory and all of its parents
 
- ### Notes:
- Will return the timestamp of the message in case you want to update it later
+ ## Create a directory and all of its parents (like `mkdir -p`)
 
- To use, you will need to go to api.slack.com, and get an bot token for whichever DM or channel you want to message.
+ ### Return value
+ Returns 0 on success (including if the directory already exists), 1 otherwise
 */
-std::string slackBotPost(std::string token,std::string channel,std::string message){
-    system(("curl -X POST -H 'Authorization: Bearer "+token+"' -H 'Content-type: application/json' --data '{\"channel\":\""+channel+"\",\"text\":\""+message+"\"}' https://slack.com/api/chat.postMessage -s | grep -e \"\\\"ts\\\":\\\"[0-9.]*\\\"\" -o | grep \"[0-9.]*\" -o > slack.bot.timestamp.log.tmp").c_str());
-    std::ifstream ts("slack.bot.timestamp.log.tmp");
-    std::string timestamp; ts >> timestamp;
-    system("rm slack.bot.timestamp.log.tmp");
-    return timestamp;
+bool makeDirectory(string dir){
+    for(size_t i=1;i<=dir.size();i++){
+        if(i<dir.size() && dir[i]!='/') continue;
+        if(mkdir(dir.substr(0,i).c_str(),0755) && errno!=EEXIST) return 1;
+    }
+    return 0;
 }
 
 
 /**
- @brief Update message posted as slack bot
-
- ## Updates slack message
-
- ### Arguments:
- * `string token` - Bot oath2 token to use
- * `string channel` - Channel to post to (Bot must have access to this channel)
- * `string ts` - Timestamp of post to update
- * `string message` - New message
+ @brief Quote a string for JSON
 
- ### Notes:
- To use, you will need to go to api.slack.com, and get an bot token for whichever DM or channel you want to message.
+ ## Quote a string for JSON
 */
-void slackBotUpdate(std::string token,std::string channel,std::string ts,std::string message){
-    system(("curl -X POST -H 'Authorization: Bearer "+token+"' -H 'Content-type: application/json' --data '{\"channel\":\""+channel+"\",\"ts\":\""+ts+"\",\"text\":\""+message+"\"}' https://slack.com/api/chat.update -s -o /dev/null").c_str());
+string jsonQuote(string value){
+    string quoted = "\"";
+    for(auto& c:value){
+        if(c=='"' || c=='\\') quoted += '\\';
+        if((unsigned char)c<0x20){
+            char escaped[8];
+            snprintf(escaped,sizeof(escaped),"\\u%04x",c);
+            quoted += escaped;
+        } else quoted += c;
+    }
+    return quoted+"\"";
 }
 
 
 /**
-@brief Emails user
-
- ## Email user
-
- ### Arguments:
- * `string destination` - Email to send to
- * `string message` - Message of Email
+ @brief Send a control command to a running campaign (`autoMEGA ctl`)
 
- ### Notes:
- To email when program is complete, in your main, add the following line: `std::atexit(email(destination,message));`
-
- Also, please use this sparingly. If any major email providers decide that it is spam, then its going to be broken for everyone on cronos forever.
-*/
-void email(std::string destination, std::string message){
-    system(("echo "+message+" | sendmail -F JARVIS "+destination).c_str());
-    return;
-}
+ ## Send a control command to a running campaign
 
+ ### Arguments
+ - `int argc`, `char** argv` - Command line, `autoMEGA ctl [--socket <path>] <command>...`
 
-/**
- @brief Print simulation status bar
-
- ## Print simulation status bar
+ ### Return value
+ Returns 0 if the command succeeded, 1 otherwise
 
  ### Notes
- Constructs status and adds a spinner to indicate that the simulation is still alive. Prints the same message to slack.
+ Prints the JSON reply of the campaign (see `controlCommand`). Run it in the campaign directory, or give the socket path.
 */
-void handleStatus(){
-    char spinner[4] = {'-','\\','|','/'};
-    unsigned int i=0;
-    string ts = "";
-    if(!token.empty() && !channel.empty()) ts=slackBotPost(token,channel,"> J.A.R.V.I.S., are you up?\nFor you sir, always.");
-    while(!exitFlag){
-        stringstream currentStatus;
-        if(statusBar[0]) currentStatus << std::setprecision(3) << "Geomega: " << ((double) statusBar[1]*100)/statusBar[2] << "% ["+to_string(statusBar[1])+"/"+to_string(statusBar[2])+"] | ";
-        if(statusBar[3]) currentStatus << std::setprecision(3) << "Cosima: " << ((double) statusBar[4]*100)/statusBar[5] << "% ["+to_string(statusBar[4])+"/"+to_string(statusBar[5])+"] | ";
-        if(statusBar[6]) currentStatus << std::setprecision(3) << "Revan: " << ((double) statusBar[7]*100)/statusBar[8] << "% ["+to_string(statusBar[7])+"/"+to_string(statusBar[8])+"] | ";
-        if(averageTime.count()!=0) currentStatus << "Running average time: " + beautify_duration(averageTime) + " | ";
-        cout << "\r" << currentStatus.str() << spinner[i++%4] << "        " << flush;
-        if(i%5==0 && !token.empty() && !channel.empty()) slackBotUpdate(token,channel,ts,currentStatus.str()+spinner[i++%4]);
-        usleep(400000);
+int controlClient(int argc, char** argv){
+    string path = "autoMEGA.sock", request;
+    for(int i=2;i<argc;i++){
+        if(string(argv[i])=="--socket" && i<argc-1) path = argv[++i];
+        else request += (request.empty()?"":" ")+string(argv[i]);
     }
+    if(request.empty()){
+        cerr << "Usage: autoMEGA ctl [--socket <path>] status|threads <n>|pause|suspend|resume|drain|front run|geometry <n>..." << endl;
+        return 1;
+    }
+    string reply;
+    if(automega::request(path,request,reply)){
+        cerr << "Could not connect to \""+path+"\". Is a campaign running in this directory?" << endl;
+        return 1;
+    }
+    cout << reply << flush;
+    return (reply.compare(0,10,"{\"ok\":true")==0)?0:1;
 }
 
 
 /**
- @brief Quick alias for slack notifications
-
- ## Alias for slack notifications
-
- ### Notes:
- Only prints slack message if it has a valid token and channel
-*/
-void quickSlack(string message,int verbosity=0){
-    if(!token.empty() && !channel.empty() && verbosity<=slackVerbosity) slackBotPost(token,channel,message);
-    cerr << message << endl;
-}
-
-
-/**
- @brief Parse iterative nodes in list or pattern mode
+ @brief Read a number from a JSON reply of `controlCommand`
 
- ## Parse iterative nodes
+ ## Read a number from a JSON reply of `controlCommand`
 
  ### Arguments
- * `YAML::NODE contents` - Node to parse
+ - `const string& json` - Reply
+ - `vector<string> keys` - Keys leading to the number, eg. `{"queues","runs"}` (each one is searched after the previous one)
 
- ### Notes
- There are two distinct parsing modes. If there are exactly three elements in the list, then it assumes it is in the format [first value, last value, step size]. If there is exactly one element, it is assumed it is a list of all values to use.
+ ### Return value
+ The number, or -1 if it is not found
 
- Values are assumed as doubles if they are in three element format, otherwise they are assumed as strings.
+ ### Notes
+ Only meant for the replies of `controlCommand`, whose keys always come in the same order.
 */
-vector<string> parseIterativeNode(YAML::Node contents, std::string prepend=""){
-    vector<string> options; options.push_back(prepend);
-    vector<string> newOptions;
-    if(contents.size()==0) quickSlack("Warning: PARSEITERATIVENODE: Empty iterative node set.",1);
-    for(size_t i=0;i<contents.size();i++){
-        // Parse options into vector of strings
-        vector<string> parameters;
-        if(contents[i].size()==3 && contents[i][0].size()==0 && contents[i][1].size()==0 && contents[i][2].size()==0){
-            double initial = contents[i][0].as<double>();
-            double final = contents[i][1].as<double>();
-            double step = contents[i][2].as<double>();
-            if((final-initial)*step < 0) quickSlack("Warning: PARSEITERATIVENODE: Step size of opposite sign to difference between final and initial values.",1);
-            for(int total=0;initial<final;initial+=step){
-                parameters.push_back(to_string(initial));
-                if(total++>100000){
-                    quickSlack("PARSEITERATIVENODE: More than 100000 options generated. This will likely cause RAM issues. This is likely due to a step size that is too small or of the wrong sign. Exiting.");
-                    exitFlag=1;
-                    vector<string> empty; return empty;
-                }
-            }
-        } else if(contents[i].size()==1){
-            if(contents[i][0].size()==0){
-                parameters.push_back("");
-                quickSlack("Warning: PARSEITERATIVENODE: Empty iterative node.",1);
-            }
-            for(size_t j=0;j<contents[i][0].size();j++){
-                if(std::find(parameters.begin(),parameters.end(),contents[i][0][j].as<string>())!=parameters.end()) quickSlack("Warning: PARSEITERATIVENODE: Duplicate value in literal iterator.",1);
-                parameters.push_back(contents[i][0][j].as<string>());
-            }
-        } else{
-            quickSlack("PARSEITERATIVENODE: Malformed iterative node. Please see manual on correct format for iterative nodes. Exiting.");
-            exitFlag=1;
-            vector<string> empty; return empty;
-        }
-        for(size_t j=0;j<options.size();j++){
-            for(size_t k=0;k<parameters.size();k++)
-                newOptions.push_back(options[j]+" "+parameters[k]);
-        }
-        options.clear();
-        options = std::move(newOptions);
+long jsonNumber(const string& json, vector<string> keys){
+    size_t position = 0;
+    for(auto& key:keys){
+        position = json.find("\""+key+"\":",position);
+        if(position==string::npos) return -1;
+        position += key.size()+3;
     }
-    return options;
+    while(position<json.size() && (json[position]=='{' || json[position]==' ')) position++;
+    return (position<json.size() && (isdigit(json[position]) || json[position]=='-'))?atol(json.c_str()+position):-1;
 }
 
 
 /**
- @brief Outputs (to file) input file with all included files fully evaluated
+ @brief Start the process of a campaign submitted to the daemon
 
- ## Output (to to file) input file with all included files fully evaluated
+ ## Start the process of a campaign submitted to the daemon
 
  ### Arguments
- - `string inputFile` - Input filename
- - `ofstream& out` - Ofstream output object
-*/
-int geoMerge(string inputFile, ofstream& out, int recursionDepth=0){
-    if(recursionDepth>1024){
-        quickSlack("GEOMERGE: Exceeded max recursion depth of 1024. This is likely due to a circular dependency. If not, then your geometry is way to complex. Exiting.",1);
-        return -1;
-    }
-    if(recursionDepth==0) out << "///Include " << inputFile << "\n"; // Note initial file
+ - `daemonCampaign& campaign` - Campaign to start
+ - `int threads` - Threads it starts with (0 to start it held, see `autoMEGA ctl pause`)
 
-    // Open file
-    ifstream input(inputFile);
-    if(!input.is_open() || !input.good()){
-        quickSlack("GEOMERGE: Could not open included file \"" + inputFile + "\".",1);
-        return 1;
-    }
+ ### Return value
+ Returns 0 on success, 1 otherwise
 
-    // Loop over file
-    for(string line;getline(input,line);){
-        stringstream ss(line);
-        string command; ss >> command;
-
-        //  Include other files
-        if(command=="Include"){
-            out << "///" << line << "\n";
-            string includedFile; ss >> includedFile;
-            string baseFile = includedFile;
-            if(includedFile[0]!='/') includedFile=inputFile.substr(0,inputFile.find_last_of('/'))+"/"+includedFile; // Workaround for relative file references
-            if(geoMerge(includedFile,out,recursionDepth+1)) return 1;
-            out << "///End " << baseFile << "\n";
-        }else{
-            out << line << "\n";
-        }
+ ### Notes
+ The campaign runs in its own directory and process group, without status bar, with its output appended to `campaign<id>.log` in the directory of the daemon, and its control socket at `autoMEGA.sock` in its directory. A campaign started without threads starts held, so it starts no job until the daemon resumes it.
+*/
+bool daemonStart(daemonCampaign& campaign, int threads){
+    char executable[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe",executable,sizeof(executable)-1);
+    if(length<0) return 1;
+    executable[length] = 0;
+    string log = absolutePath("campaign"+to_string(campaign.id)+".log");
+    string count = to_string(max(threads,1));
+
+    pid_t pid = fork();
+    if(pid<0) return 1;
+    if(pid==0){
+        setpgid(0,0);
+        int input = open("/dev/null",O_RDONLY);
+        int output = open(log.c_str(),O_WRONLY|O_CREAT|O_APPEND,0644);
+        if(chdir(campaign.directory.c_str())!=0 || input<0 || output<0) _exit(127);
+        dup2(input,STDIN_FILENO);
+        dup2(output,STDOUT_FILENO);
+        dup2(output,STDERR_FILENO);
+        vector<const char*> arguments = {"autoMEGA","--settings",campaign.settings.c_str(),"--threads",count.c_str(),"--socket","autoMEGA.sock","--existing",campaign.existing.c_str(),"--quiet"};
+        if(threads<1) arguments.push_back("--hold");
+        arguments.push_back(NULL);
+        execv(executable,(char* const*)arguments.data());
+        _exit(127);
     }
-
-    if(recursionDepth==0) out << "///End " << inputFile << "\n"; // Note final file
+    campaign.pid = pid;
+    campaign.sent = threads;
     return 0;
 }
 
 
 /**
+ @brief Share the threads of the daemon between its campaigns
 
- @brief Check geometry file using checkGeometry
-
- ## Check geometry file using checkGeometry
-
- ### Arguments
- - `string& filename` - Geometry file to test
- - `string path` - Path to folder containing checkGeometry
+ ## Share the threads of the daemon between its campaigns
 
  ### Notes
- filename will be empty after the test if it is invalid
+ Must be called with `campaignLock` held. Higher priority classes are served first. Within a class, threads are handed out one at a time to the campaign with the fewest threads per unit of weight, among those with more jobs (running or waiting) than threads, which is a weighted max-min fair share: a campaign never gets more threads than it has jobs, and what it does not need goes to the others.
 */
-void testGeometry(string& filename, string path){
-    int status, ret=system((path+"/checkGeometry "+filename+" > /dev/null 2> /dev/null").c_str());
-    status=WEXITSTATUS(ret); // Get return value
-    if(status){
-        quickSlack("GEOMEGA: Geometry error in geometry \""+filename+"\". Removing geometry from list.",1);
-        filename="";
-        statusBar[2]--;
-    } else statusBar[1]++;
-    currentThreadCount--;
+void daemonAllocate(){
+    int remaining = daemonThreads;
+    set<int> priorities;
+    for(auto& campaign:campaigns){
+        campaign.allocated = 0;
+        if(campaign.pid!=0) priorities.insert(campaign.priority);
+    }
+    for(auto priority=priorities.rbegin();priority!=priorities.rend() && remaining>0;++priority){
+        while(remaining>0){
+            daemonCampaign* next = NULL;
+            for(auto& campaign:campaigns){
+                if(campaign.pid==0 || campaign.priority!=*priority || campaign.allocated>=campaign.running+campaign.waiting) continue;
+                if(next==NULL || (campaign.allocated+1)/campaign.weight<(next->allocated+1)/next->weight) next = &campaign;
+            }
+            if(next==NULL) break;
+            next->allocated++;
+            remaining--;
+        }
+    }
 }
 
 
 /**
- @brief Parse geomega settings and setup .geo.setup files
+ @brief Execute one daemon command
 
- ## Parse geomega settings and setup .geo.setup files
+ ## Execute one daemon command
 
  ### Arguments
- - `YAML::NODE geomega` - Geomega node to aprse settings from
- - `vector<string> &geometries` - Vector of filenames of generated files (return by reference)
+ - `string request` - Command, eg. `submit /data/sweep/config.yaml weight 2`
 
  ### Return value
- Returns the success value: 0 for success, return code otherwise
+ JSON reply, with `"ok"` set to whether the command succeeded
 
  ### Notes
- Merges all dependencies into a single file, my default g.geo.setup, then creates additional files from there. In my experience this has worked fine, but let me know if there is a problem with your geometry.
+ Commands:
+ - `submit <settings> [directory <dir>] [weight <w>] [priority <p>] [legend <name>] [clean]` - Start a campaign. Paths are relative to the directory of the daemon. The campaign runs in the directory of its settings file unless another one is given. Files already there are kept, unless `clean` is given.
+ - `status` - Threads, and state, share and progress of every campaign
+ - `threads <n>` - Change the number of threads shared by the campaigns
+ - `weight <id> <w>` and `priority <id> <p>` - Change the share of a campaign
+ - `drain <id>` - Drain a campaign (see `controlCommand`)
+ - `shutdown` - Drain every campaign, and exit once they are done
 */
-int geomegaSetup(YAML::Node geomega, vector<string> &geometries){
-    // Update status
-    statusBar[0]=1;
-
-    // Merge all files together
-    ofstream baseGeometry("g.geo.setup");
-    if(!baseGeometry.is_open()){quickSlack("GEOMEGA SETUP: Could not create new base geometry file. Exiting.",1); return 3;}
-    if(geoMerge(geomega["filename"].as<string>(),baseGeometry)) return 1;
-    baseGeometry.close();
-
-    // Generate all options
-    vector<string> files;
-    vector<int> lines;
-    vector<vector<string>> options;
-    if(geomega["parameters"].size()!=0){
-        for(YAML::const_iterator it=geomega["parameters"].begin();it != geomega["parameters"].end();++it){
-            auto location = std::find(files.begin(), files.end(), it->second["filename"].as<string>());
-            if(location != files.end() && lines[location-files.begin()]==it->second["lineNumber"].as<int>()){
-                quickSlack("GEOMEGA SETUP: Multiple parameters alter the same line in the file. Exiting.");
-                return 4;
-            }
-
-            files.push_back(it->second["filename"].as<string>());
-            lines.push_back(it->second["lineNumber"].as<int>());
-            options.push_back(parseIterativeNode(it->second["contents"]));
-            if(exitFlag) return 6;
+string daemonCommand(string request){
+    stringstream ss(request);
+    string command; ss >> command;
+    lock_guard<mutex> lock(campaignLock);
+    if(command=="submit"){
+        if(daemonShutdown) return "{\"ok\":false,\"error\":\"shutting down\"}";
+        daemonCampaign campaign;
+        ss >> campaign.settings;
+        if(campaign.settings.empty() || !fileExists(campaign.settings)) return "{\"ok\":false,\"error\":"+jsonQuote("settings file \""+campaign.settings+"\" does not exist")+"}";
+        campaign.settings = absolutePath(campaign.settings);
+        campaign.directory = campaign.settings.substr(0,campaign.settings.find_last_of('/'));
+        for(string option;ss >> option;){
+            if(option=="directory") ss >> campaign.directory;
+            else if(option=="weight") ss >> campaign.weight;
+            else if(option=="priority") ss >> campaign.priority;
+            else if(option=="legend") ss >> campaign.legend;
+            else if(option=="clean") campaign.existing = "clean";
+            else return "{\"ok\":false,\"error\":"+jsonQuote("unknown option \""+option+"\"")+"}";
         }
-
-        for(size_t i=0;i<options.size();i++){
-            for(size_t j=0;j<options[i].size();j++){
-                if(options[i][j].find('\n') != std::string::npos){
-                    quickSlack("GEOMEGA SETUP: One or more parameters include newlines. This creates undefined behavior. Exiting.");
-                    return 5;
-                }
-            }
+        if(campaign.weight<=0) return "{\"ok\":false,\"error\":\"weight must be positive\"}";
+        campaign.directory = absolutePath(campaign.directory);
+        if(makeDirectory(campaign.directory)) return "{\"ok\":false,\"error\":"+jsonQuote("could not create \""+campaign.directory+"\"")+"}";
+        if(campaign.directory.size()+string("/autoMEGA.sock").size()>=sizeof(sockaddr_un::sun_path)) return "{\"ok\":false,\"error\":\"campaign directory path is too long for its control socket\"}";
+        for(auto& other:campaigns) if(other.pid!=0 && other.directory==campaign.directory) return "{\"ok\":false,\"error\":"+jsonQuote("campaign "+to_string(other.id)+" already runs in \""+campaign.directory+"\"")+"}";
+        if(campaign.legend.empty()) campaign.legend = campaign.directory.substr(campaign.directory.find_last_of('/')+1);
+        campaign.id = campaigns.size()+1;
+
+        // Start with its share, assuming it has enough jobs to use it
+        campaigns.push_back(campaign);
+        campaigns.back().pid = -1;
+        daemonAllocate();
+        int threads = campaigns.back().allocated;
+        if(daemonStart(campaigns.back(),threads)){
+            campaigns.pop_back();
+            return "{\"ok\":false,\"error\":\"could not start the campaign\"}";
         }
-
-        legendLock.lock();
-        legend.open("geo.legend");
-
-        // Create new files
-        vector<size_t> odometer(lines.size(),0);
-        int position=odometer.size()-1;
-        while(position>=0){
-            if(odometer[position]==options[position].size()){
-                odometer[position]=0;
-                if(--position<0) break;
-                odometer[position]++;
-            } else {
-                statusBar[2]++;
-                // Create legend
-                legend << "Geometry";
-                for(auto& o:odometer) legend << "." << o;
-                legend << "\n";
-                for(size_t i=0;i<lines.size();i++) legend << "File:" << files[i] << "\nLine: " << lines[i] << "\nOption: " << options[i][odometer[i]] << "\n";
-                legend << "\n";
-
-                // Read base geometry
-                ifstream baseGeometryIn("g.geo.setup");
-                stringstream alteredGeometry;
-                copy(istreambuf_iterator<char>(baseGeometryIn),istreambuf_iterator<char>(),ostreambuf_iterator<char>(alteredGeometry));
-
-                // Alter geometry
-                for(size_t i=0;i<odometer.size();i++){
-                    stringstream newGeometry;
-                    string line;
-
-                    bool foundFile = 0;
-                    // Seek to "///Include "+files[i]
-                    while(getline(alteredGeometry,line)){
-                        newGeometry << line << "\n";
-                        if(line=="///Include "+files[i]){ foundFile=1; break;}
-                    }
-
-                    // Make sure we found the file
-                    if(!foundFile){
-                        quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
-                        return 5;
-                    }
-
-                    // Seek lines[i] lines ahead
-                    for(int j=0;j<lines[i]-1;j++){
-                        getline(alteredGeometry,line);
-                        newGeometry << line << "\n";
-
-                        stringstream newLine(line);
-                        string command,file; newLine >> command >> file;
-                        // Skip over other includes
-                        if(command=="///Include"){
-                            while(getline(alteredGeometry,line)){
-                                newGeometry << line << "\n";
-                                // Check we havent passed "///End "+files[i]
-                                if(line=="///End "+files[i]){
-                                    quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
-                                    return 4;
-                                }
-                                if(line=="///End "+file) break;
-                            }
-                        }
-                        // Check we havent passed "///End "+files[i]
-                        if(line=="///End "+files[i]){
-                            quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
-                            return 4;
-                        }
-                    }
-
-                    // Replace that line with options[i][odometer[i]]
-                    getline(alteredGeometry,line);
-                    line=options[i][odometer[i]];
-                    newGeometry<<line<<"\n";
-
-                    // Copy rest of stream and swap streams
-                    while(getline(alteredGeometry,line)) newGeometry << line << "\n";
-                    alteredGeometry.swap(newGeometry);
-                }
-
-                // Create new file
-                string fileName = "g";
-                for(auto& o:odometer) fileName+="."+to_string(o);
-                fileName+=".geo.setup";
-                ofstream newGeometry(fileName);
-                geometries.push_back(fileName);
-
-                // Write to file and close it
-                newGeometry << alteredGeometry.rdbuf();
-                newGeometry.close();
-
-                // Manage odometer
-                position=odometer.size()-1;
-                odometer[position]++;
+        cerr << "Campaign "+to_string(campaign.id)+" ("+campaign.legend+") started in \""+campaign.directory+"\"." << endl;
+        return "{\"ok\":true,\"campaign\":"+to_string(campaign.id)+"}";
+    }
+    if(command=="status"){
+        stringstream reply;
+        reply << "{\"ok\":true,\"threads\":" << daemonThreads << ",\"shutdown\":" << (daemonShutdown?"true":"false") << ",\"campaigns\":[";
+        for(size_t i=0;i<campaigns.size();i++){
+            daemonCampaign& c = campaigns[i];
+            reply << (i?",":"") << "{\"id\":" << c.id << ",\"legend\":" << jsonQuote(c.legend) << ",\"settings\":" << jsonQuote(c.settings) << ",\"directory\":" << jsonQuote(c.directory)
+                  << ",\"weight\":" << c.weight << ",\"priority\":" << c.priority << ",\"state\":\"" << ((c.pid!=0)?"running":((c.exit==0)?"done":"failed")) << "\""
+                  << ",\"threads\":" << c.allocated << ",\"jobs\":{\"running\":" << c.running << ",\"waiting\":" << ((c.waiting==INT_MAX/2)?0:c.waiting) << "}"
+                  << ",\"runs\":{\"done\":" << c.done << ",\"total\":" << c.total << "},\"exit\":" << c.exit << "}";
+        }
+        reply << "]}";
+        return reply.str();
+    }
+    if(command=="threads"){
+        int threads = 0;
+        if(!(ss >> threads) || threads<1) return "{\"ok\":false,\"error\":\"usage: threads <n>, with n at least 1\"}";
+        daemonThreads = threads;
+        return "{\"ok\":true,\"threads\":"+to_string(threads)+"}";
+    }
+    if(command=="shutdown"){
+        daemonShutdown = 1;
+        string reply;
+        for(auto& campaign:campaigns) if(campaign.pid>0) automega::request(campaign.directory+"/autoMEGA.sock","drain",reply);
+        return "{\"ok\":true}";
+    }
+    if(command=="weight" || command=="priority" || command=="drain"){
+        int id = 0;
+        double value = 0;
+        ss >> id;
+        if(command!="drain" && !(ss >> value)) return "{\"ok\":false,\"error\":"+jsonQuote("usage: "+command+" <id> <value>")+"}";
+        for(auto& campaign:campaigns){
+            if(campaign.id!=id) continue;
+            if(command=="weight"){
+                if(value<=0) return "{\"ok\":false,\"error\":\"weight must be positive\"}";
+                campaign.weight = value;
+            } else if(command=="priority") campaign.priority = value;
+            else {
+                string reply;
+                if(campaign.pid<=0 || automega::request(campaign.directory+"/autoMEGA.sock","drain",reply)) return "{\"ok\":false,\"error\":\"campaign is not running\"}";
             }
+            return "{\"ok\":true}";
         }
-        legend.close();
-        legendLock.unlock();
-    } else geometries.push_back("g.geo.setup");
-
-    // Get current path
-    char result[ 1024 ];
-    ssize_t count = readlink("/proc/self/exe", result, 1024);
-    string path = (count != -1)?dirname(result):".";
-
-    vector<thread> threadpool;
-    // Verify all geometries
-    if(!test) for(size_t i=0;i<geometries.size();i++){
-        while(currentThreadCount>=maxThreads)usleep(100000);
-        threadpool.push_back(thread(testGeometry,std::ref(geometries[i]),path));
-        currentThreadCount++;
-    } else for(size_t i=0;i<geometries.size();i++) cout << (path+"/checkGeometry "+geometries[i]) << endl;
-
-    // Join simulation threads
-    for(size_t i=0;i<threadpool.size();i++) threadpool[i].join();
-    // Properly order vector and remove empty strings (failed geometries)
-    std::sort(geometries.begin(), geometries.end());
-    geometries.erase(std::remove(geometries.begin(), geometries.end(), ""), geometries.end());
-
-
-    return 0;
+        return "{\"ok\":false,\"error\":"+jsonQuote("no campaign "+to_string(id))+"}";
+    }
+    return "{\"ok\":false,\"error\":"+jsonQuote("unknown command \""+command+"\"")+"}";
 }
 
 
 /**
- @brief Parse cosima settings and setup source files
+ @brief Run several campaigns side by side, sharing the threads of the node (`autoMEGA daemon`)
 
- ## Parse cosima settings and setup source files
+ ## Run several campaigns side by side
 
  ### Arguments
- - `YAML::Node cosima` - Cosima node to parse settings from
- - `vector<string> &sources` - Vector of strings of output filenames (return by reference)
- - `vector<string> &geometries` - Vector of strings of geometry filenames
+ - `int argc`, `char** argv` - Command line, `autoMEGA daemon [--threads <n>] [--socket <path>] [--exit] [<settings>...]`
 
  ### Return value
- Returns the success value: 0 for success, return code otherwise.
+ Returns 0 if every campaign succeeded, 1 otherwise
 
  ### Notes
- Only replaces line in a source file, it does not add them as that would be undefined behavior. Make sure that all of your operations replace lines, otherwise they will not be parsed correctly. This may not always throw an error, so manually check that your iterations are properly parsing.
-*/
-int cosimaSetup(YAML::Node cosima, vector<string> &sources, vector<string> &geometries){
-    // Update status
-    statusBar[3]=statusBar[6]=1;
-
-    // Make sure config file exists
-    string baseFileName = cosima["filename"].as<string>();
-    if(!fileExists(baseFileName)){
-        quickSlack("COSIMA SETUP: File \"" + baseFileName + "\" does not exist, but was requested. Exiting.",1);
-        return 1;
-    }
+ Each settings file given is submitted as a campaign (see `daemonCommand`), and more can be submitted with `autoMEGA ctl --socket <path> submit <settings>`. The socket defaults to `autoMEGA.daemon.sock`. Every second, the daemon asks every campaign for its jobs, shares `--threads` (the number of hardware threads by default) between them (see `daemonAllocate`), and sets their thread counts accordingly, pausing the campaigns left without threads. Campaigns given fewer threads than they are running finish their running jobs first, so the node is briefly busier than `--threads` after a change.
 
-    // Parse iterative nodes, but need to specially format them with the correct source and name.
-    map<string,vector<string>> options;
-    for(YAML::const_iterator it=cosima["parameters"].begin();it != cosima["parameters"].end();++it){
-        if(it->second["beam"]) options[it->second["source"].as<string>()+".Beam"] = parseIterativeNode(it->second["beam"],it->second["source"].as<string>()+".Beam");
-        if(it->second["spectrum"]) options[it->second["source"].as<string>()+".Spectrum"] = parseIterativeNode(it->second["spectrum"],it->second["source"].as<string>()+".Spectrum");
-        if(it->second["flux"]) options[it->second["source"].as<string>()+".Flux"] = parseIterativeNode(it->second["flux"],it->second["source"].as<string>()+".Flux");
-        if(it->second["polarization"]) options[it->second["source"].as<string>()+".Polarization"] = parseIterativeNode(it->second["polarization"],it->second["source"].as<string>()+".Polarization");
-        if(it->second["particleType"]) options[it->second["source"].as<string>()+".ParticleType"] = parseIterativeNode(it->second["particleType"],it->second["source"].as<string>()+".ParticleType");
-        if(exitFlag) return 6;
-    }
-    string timing[2] = {"",""};
-    if(cosima["events"]){
-        if(timing[0]=="") {
-            timing[0]="Events"; timing[1]=cosima["events"].as<string>();
-        } else {
-            quickSlack("COSIMA SETUP: Multiple timing definitions. Exiting.",1);
-            return 1;
-        }
+ With `--exit`, the daemon exits once every campaign is done. Otherwise it runs until `shutdown`, SIGINT or SIGTERM (which interrupts every campaign).
+*/
+int daemonMain(int argc, char** argv){
+    string path = "autoMEGA.daemon.sock";
+    bool exitWhenDone = 0;
+    vector<string> initial;
+    for(int i=2;i<argc;i++){
+        if(string(argv[i])=="--threads" && i<argc-1) daemonThreads = max(atoi(argv[++i]),1);
+        else if(string(argv[i])=="--socket" && i<argc-1) path = argv[++i];
+        else if(string(argv[i])=="--exit") exitWhenDone = 1;
+        else initial.push_back(argv[i]);
     }
-    if(cosima["triggers"]){
-        if(timing[0]=="") {
-            timing[0]="Triggers"; timing[1]=cosima["triggers"].as<string>();
-        } else {
-            quickSlack("COSIMA SETUP: Multiple timing definitions. Exiting.",1);
-            return 1;
-        }
+    signal(SIGINT,[](int sig){ interrupted = 1; signal(sig,SIG_DFL); });
+    signal(SIGTERM,[](int sig){ interrupted = 1; signal(sig,SIG_DFL); });
+    signal(SIGPIPE,SIG_IGN);
+
+    thread controlThread([&path](){
+        if(automega::serve(path,daemonCommand,exitFlag)) cerr << "DAEMON: Could not listen on \""+path+"\". Runtime control is disabled." << endl;
+    });
+    for(auto& settings:initial){
+        string reply = daemonCommand("submit "+settings);
+        if(reply.compare(0,10,"{\"ok\":true")!=0) cerr << "DAEMON: Could not submit \""+settings+"\": "+reply << endl;
     }
-    if(cosima["time"]){
-        if(timing[0]=="") {
-            timing[0]="Time"; timing[1]=cosima["time"].as<string>();
-        } else {
-            quickSlack("COSIMA SETUP: Multiple timing definitions. Exiting.",1);
-            return 1;
+    cout << "Sharing "+to_string(daemonThreads)+" threads between campaigns.\nTo submit a campaign:\n"+string(argv[0])+" ctl --socket "+absolutePath(path)+" submit <settings> [weight <w>] [priority <p>]\n" << endl;
+
+    char spinner[4] = {'-','\\','|','/'};
+    unsigned int tick = 0;
+    bool forwarded = 0;
+    while(1){
+        // Poll every campaign
+        campaignLock.lock();
+        vector<pair<int,string>> sockets;
+        for(size_t i=0;i<campaigns.size();i++) if(campaigns[i].pid>0) sockets.push_back(make_pair(i,campaigns[i].directory+"/autoMEGA.sock"));
+        campaignLock.unlock();
+        map<int,string> replies;
+        for(auto& socket:sockets){
+            string reply;
+            if(!automega::request(socket.second,"status",reply)) replies[socket.first] = reply;
         }
-    }
-    if(geometries.size()!=0){
-        for(auto& g : geometries) g = "Geometry "+g;
-        options["Geometry"] = geometries;
-    }
 
-    // Read base geometry
-    ifstream baseSource(cosima["filename"].as<string>());
-    stringstream baseSourceStream;
-    copy(istreambuf_iterator<char>(baseSource),istreambuf_iterator<char>(),ostreambuf_iterator<char>(baseSourceStream));
-    vector<string> alteredSources;
-    alteredSources.push_back(baseSourceStream.str());
-
-    // Parse cosima parameters to create a bunch of base run?.source files
-    for(auto &elem:options){
-        vector<string> newSources;
-        for(auto &option:elem.second){
-            for(auto &s : alteredSources){
-                stringstream alteredSource(s);
-                stringstream newSource;
-                for(string line; getline(alteredSource,line);){
-                    stringstream ss(line);
-                    string command; ss >> command;
-                    if(command==elem.first){
-                        newSource << option << "\n";
-                    } else newSource << line << "\n";
+        campaignLock.lock();
+        // Collect campaigns that exited
+        bool active = 0, submitted = !campaigns.empty();
+        for(auto& campaign:campaigns){
+            if(campaign.pid>0){
+                int status = 0;
+                if(waitpid(campaign.pid,&status,WNOHANG)==campaign.pid){
+                    campaign.pid = 0;
+                    campaign.exit = WIFEXITED(status)?WEXITSTATUS(status):128+WTERMSIG(status);
+                    cerr << "Campaign "+to_string(campaign.id)+" ("+campaign.legend+") "+((campaign.exit==0)?"complete.":"exited with return code "+to_string(campaign.exit)+" (see campaign"+to_string(campaign.id)+".log).") << endl;
                 }
-                newSources.push_back(newSource.str());
             }
+            active |= campaign.pid>0;
         }
-        alteredSources.swap(newSources);
-    }
-
-    for(size_t i=0;i<alteredSources.size();i++){
-        string filename = "run"+to_string(i)+".source";
-        sources.push_back(filename);
-        ofstream out(filename);
-        // Fix output filename
-        regex e(".FileName.*\n");
-        string updated = regex_replace(alteredSources[i],e,".FileName run"+to_string(i)+"\n");
-
-        // Update Triggers, Events, or Time
-        if(!timing[0].empty()){
-            regex t("\\..?"+timing[0]+".*\n");
-            updated = regex_replace(updated,t,"\."+timing[0]+" "+timing[1]+"\n");
+        for(auto& reply:replies){
+            daemonCampaign& campaign = campaigns[reply.first];
+            long running = jsonNumber(reply.second,{"threads","running"}), checks = jsonNumber(reply.second,{"queues","checks"}), runs = jsonNumber(reply.second,{"queues","runs"});
+            if(running<0 || checks<0 || runs<0) continue;
+            campaign.running = running;
+            campaign.waiting = checks+runs;
+            for(size_t position=reply.second.find("\"queued\":");position!=string::npos;position=reply.second.find("\"queued\":",position+1)) campaign.waiting += atol(reply.second.c_str()+position+9);
+            // Geometry variants still being written count as one waiting job, so the campaign keeps a thread
+            if(reply.second.find("\"geometryDone\":false")!=string::npos) campaign.waiting++;
+            campaign.done = max(jsonNumber(reply.second,{"runs","done"}),0L);
+            campaign.total = max(jsonNumber(reply.second,{"runs","total"}),0L);
         }
 
-        out << updated;
-        out.close();
-    }
-
-    // Update status
-    statusBar[5]=statusBar[8]=alteredSources.size();
-    return 0;
-}
-
-
-/**
- @brief Runs the Cosima simulation and Revan data reduction for one set of parameters
-
- ##  Runs the Cosima simulation and Revan data reduction for one set of parameters
-
- ### Arguments
- - `const string source` - *.source file for cosima
- - `const int threadNumber` - Thread number to avoid file name collisions
-
- ### Notes
- Often runs out of storage if you are not careful
+        // Share the threads, and tell every campaign its share
+        daemonAllocate();
+        for(auto& campaign:campaigns){
+            if(campaign.pid<=0 || campaign.allocated==campaign.sent || !replies.count(&campaign-&campaigns[0])) continue;
+            string reply, socket = campaign.directory+"/autoMEGA.sock";
+            if(campaign.allocated==0) automega::request(socket,"pause",reply);
+            else if(!automega::request(socket,"threads "+to_string(campaign.allocated),reply) && campaign.sent==0) automega::request(socket,"resume",reply);
+            campaign.sent = campaign.allocated;
+        }
 
-*/
-void runSimulation(const string source, const int threadNumber){
-    // Setup
-    uint32_t seed = random_seed<uint32_t>(1);
-    auto start = chrono::steady_clock::now();
-
-    // Create legend
-    legendLock.lock();
-    legend << "Run number " << threadNumber << ":\nSource: " << source << "\nSeed:" << to_string(seed) << "\n" << endl;
-    legendLock.unlock();
-
-    // Get geometry file
-    ifstream sourceFile(source);
-    string geoSetup;
-    while(!sourceFile.eof() && geoSetup!="Geometry") sourceFile>>geoSetup;
-    if(geoSetup!="Geometry"){cerr << "Cannot locate geometry file. Exiting." << endl; if(slackVerbosity>=1) quickSlack("RUN SIMULATION"+to_string(threadNumber)+": Cannot locate geometry file."); return;}
-    sourceFile>>geoSetup;
-    sourceFile.close();
-
-    // Actually run simulation and analysis, and remove intermediary files when they are no longer necessary (unless keepAll is set)
-    if(!test){
-        // Cosima stage
-        int status, ret=system(("bash -c \"source ${MEGALIB}/bin/source-megalib.sh; cosima -v "+to_string(cosimaVerbosity)+" -z -s "+to_string(seed)+" run"+to_string(threadNumber)+".source |& xz -3 > cosima.run"+to_string(threadNumber)+".log.xz; exit $?\"").c_str());
-        status=WEXITSTATUS(ret); // Get return value
-        if(status){
-            quickSlack("Run "+to_string(threadNumber)+" failed.");
-            return;
+        // Status line
+        stringstream status;
+        for(auto& campaign:campaigns){
+            status << "#" << campaign.id << " " << campaign.legend << ": ";
+            if(campaign.pid>0) status << campaign.done << "/" << campaign.total << " runs, " << campaign.allocated << " threads | ";
+            else status << ((campaign.exit==0)?"done":"failed") << " | ";
         }
-        statusBar[4]++;
-
-        // Revan stage
-        ret=system(("bash -c \"source ${MEGALIB}/bin/source-megalib.sh; revan -c "+revanSettings+" -n -a -f run"+to_string(threadNumber)+".*.sim.gz -g "+geoSetup+" |& xz -3 > revan.run"+to_string(threadNumber)+".log.xz; exit $?\"").c_str());
-        status=WEXITSTATUS(ret); // Get return value
-        if(status){
-            quickSlack("Run "+to_string(threadNumber)+" failed.");
-            return;
+        campaignLock.unlock();
+        cout << "\r" << status.str() << spinner[tick++%4] << "        " << flush;
+
+        // Interrupt every campaign on SIGINT or SIGTERM
+        if(interrupted && !forwarded){
+            lock_guard<mutex> lock(campaignLock);
+            for(auto& campaign:campaigns) if(campaign.pid>0) kill(campaign.pid,SIGTERM);
+            forwarded = 1;
         }
-        statusBar[7]++;
-
-        // Cleanup
-        if(!keepAll) removeWildcard("run"+to_string(threadNumber)+".*.sim.gz");
-    }else{
-        // Dry run
-        cout << "bash -c \"source ${MEGALIB}/bin/source-megalib.sh; cosima -v "+to_string(cosimaVerbosity)+" -z -s "+to_string(seed)+" run"+to_string(threadNumber)+".source |& xz -3 > cosima.run"+to_string(threadNumber)+".log.xz; exit $?\"\nbash -c \"source ${MEGALIB}/bin/source-megalib.sh; revan -c "+revanSettings+" -n -a -f run"+to_string(threadNumber)+".*.sim.gz -g "+geoSetup+" |& xz -3 > revan.run"+to_string(threadNumber)+".log.xz; exit $?\"\n";
-        if(!keepAll) cout << "rm run"+to_string(threadNumber)+".*.sim.gz\n";
+        if(!active && (daemonShutdown || interrupted || (exitWhenDone && submitted))) break;
+        sleep(1);
     }
-
-    // End timer, calculate new average time
-    auto end = chrono::steady_clock::now();
-    chrono::seconds thisTime = chrono::duration_cast<chrono::seconds>(end-start);
-    timeLock.lock();
-    averageTime = (averageTime.count()!=0)?(averageTime*10+thisTime)/(11):thisTime;
-    timeLock.unlock();
-
-    // Cleanup and exit
-    currentThreadCount--;
-    return;
+    cout << endl;
+    exitFlag = 1;
+    controlThread.join();
+    lock_guard<mutex> lock(campaignLock);
+    bool failed = 0;
+    for(auto& campaign:campaigns) failed |= campaign.exit!=0;
+    return failed;
 }
 
 
@@ -848,8 +515,30 @@ void runSimulation(const string source, const int threadNumber){
 ### Arguments:
 
  - `--settings` - Settings file - defaults to "config.yaml"
+ - `--plan` - Only print the number of geometry variants and runs, and estimate the storage and wall time of the campaign from a previous catalog. Nothing is written.
+ - `--history` - Catalog of a previous campaign for `--plan` to base its estimates on - defaults to "catalog.db"
+ - `--threads` - Number of threads, overriding `maxThreads`
+ - `--socket` - Control socket, overriding `controlSocket`
+ - `--existing` - What to do with files already in the directory: `clean`, `skip`, or `exit`, instead of asking
+ - `--quiet` - Do not print the status bar, nor how to control the campaign
+ - `--hold` - Start without starting any job, until `autoMEGA ctl resume` (used by the daemon for campaigns it has no threads for yet)
  - `--test` - Enter test mode. Largely undefined behavior, but it will generally perform a dry run and limit slack notifications. Use at your own risk.
 
+`autoMEGA daemon [--threads <n>] [--socket <path>] [--exit] [<settings>...]` runs several campaigns side by side, each in its own process and directory, sharing `--threads` between them (weighted fair share within a priority class, higher classes first). Campaigns are submitted on the command line or with `autoMEGA ctl --socket autoMEGA.daemon.sock submit <settings> [directory <dir>] [weight <w>] [priority <p>] [legend <name>] [clean]`. The daemon socket also accepts `status`, `threads <n>`, `weight <id> <w>`, `priority <id> <p>`, `drain <id>`, and `shutdown`. Each campaign keeps its own catalog, notifications, and log (`campaign<id>.log`, in the directory of the daemon).
+
+`autoMEGA ctl [--socket <path>] <command>` controls a running campaign through its control socket (by default `autoMEGA.sock`, in the campaign directory), and prints its JSON reply. Commands:
+ - `status` - Threads, pause and drain flags, queue lengths and the next queued runs, runs in progress, progress (events simulated, events per second over the last minute, `eta` in seconds or -1 if not known yet, and the completion of every run in progress), and stage counters
+ - `threads <n>` - Change the number of simulation threads
+ - `pause` - Stop starting new jobs, letting the running ones finish. `resume` starts them again
+ - `suspend` - Also stop the running jobs (same as `kill -USR1`). `resume` continues them
+ - `drain` - Stop starting new jobs, and exit (with return code 4) once the running ones are done. Queued runs stay `queued` in the catalog
+ - `cancel` - Kill the running jobs, and exit (with return code 4), same as `kill -TERM`
+ - `front run <n>...` - Move runs to the front of the queue
+ - `front geometry <n>...` - Move the check of geometry variants, and their queued runs, to the front of the queues
+
+### Library:
+`libautomega` (`libautomega.h`, built as `libautomega.a` by `make`) holds the campaign engine, and runs campaigns in-process for another program, eg. an optimiser. An `automega::campaign` is given its parameter space (`geometry`, `source`, `vary` and `setting`, or a whole configuration with `configure`), submitted, and reports every run as soon as it is done through its `onRun` callback, called directly from the thread of the run with its parameter values and .tra.gz file. It can be controlled (`control`), cancelled (`cancel`), and waited for (`wait`, or the `onDone` callback). Every campaign has its own state, threads and directory, so any number of them can run at once from one program. autoMEGA itself only parses its settings file into a campaign, and forwards signals to it. Link with `-lautomega -lyaml-cpp -lsqlite3 -lz -pthread`.
+
 ### Configuration:
 Most settings are only configurable from the yaml configuration file. The format is:
 
@@ -857,12 +546,51 @@ autoMEGA settings:
  - `address` - Email to send an email to when done (relies on sendmail). If not present, email notifications are disabled. Note: depends on a system call to sendmail, so it may not work on all systems.
  - `token` - Slack OAuth2 token to send notification when done. If not present, slack notifications are disabled.
  - `channel` - Slack channel to send notification when done. (See slack API for how to obtain slack channel code, format `C12345678`). If not present, slack notifications are disabled.
- - `maxThreads` - Maximum threads to use (defaults to system threads if not given)
- - `keepAll` - Flag to keep intermediary files (defaults to off = 0)
+ - `maxThreads` - Maximum threads to use (defaults to system threads if not given). Can be changed while running with `autoMEGA ctl threads <n>`.
+ - `controlSocket` - Path of the control socket (see `autoMEGA ctl`). Defaults to `autoMEGA.sock`.
+ - `keepAll` - Flag to keep intermediary files (defaults to off = 0). Same as `retention: sim: all`.
+ - `retention` - Retention policy for the .sim.gz files:
+    - `sim` - One of `none` (delete all of them), `all` (keep all of them), `failed` (only keep them for failed runs), `first` (keep them for the first `keepFirst` runs of each geometry variant), or `pressure` (keep all of them until free storage drops below `pressureMB`, then delete the oldest first). Defaults to `none`.
+    - `keepFirst` - Number of runs per geometry variant to keep .sim.gz files for, with the `first` policy. Defaults to 1.
+    - `pressureMB` - Free storage (in MB) to keep, with the `pressure` policy. Defaults to 20000.
+ - `cleanupThreads` - Number of threads deleting files in the background (and when cleaning the directory at startup). Defaults to 8.
+ - `stream` - Flag to stream uncompressed cosima output straight into revan through a named pipe, so no .sim.gz is ever written. Both stages then run at the same time. Only used with the `none` retention policy. (defaults to off = 0)
+ - `warmGeometry` - Flag to read the files of each geometry variant (its setup file and every file it includes) into the page cache as its first run starts, and those of the next variant in the queue ahead of its runs. The files are read by the thread of the run, before it starts cosima, so only turn it on if the `setup` column of the catalog (the time every run took before its first event, mostly loading the geometry) shows a gain. Runs of a variant are queued, and so dispatched, together whether or not it is set. (defaults to off = 0)
+ - `runDirectories` - Flag to run each simulation in its own sharded directory, `runs/<run/100>/<run%100>/`, rather than all in the current directory. (defaults to off = 0)
+ - `placement` - If present, every job (geometry check, cosima and revan) is pinned to its own set of cores, read from the `/sys/devices/system/cpu` topology. Jobs share the least busy core set if there are more jobs than core sets. Busy core sets per NUMA node are shown in the status bar.
+    - `coresPerJob` - Number of physical cores (with their hyperthreads) in each core set. Core sets never span NUMA nodes. Defaults to 1.
+    - `helperCores` - Number of physical cores reserved for helper processes (the xz log compressors, pinned with taskset). Defaults to 1.
+    - `bindMemory` - Flag to bind the memory of every job to the NUMA node of its core set. Defaults to on = 1.
+ - `retries` - Number of times a failed (or timed out) run is retried, each time with a new seed derived from the master seed, the run number and the attempt. Defaults to 2.
+ - `timeouts` - If present, cosima and revan stages are killed once they take much longer than the successful stages so far:
+    - `percentile` - Percentile of the durations of the successful stages the timeout is based on. Defaults to 95.
+    - `factor` - Multiple of that percentile after which a stage is killed. Defaults to 3.
+    - `minimum` - Shortest timeout, in seconds. Defaults to 600.
+    - `minSamples` - Number of successful stages to observe before timing out any stage. Defaults to 10.
+ - `speculation` - If present, once nothing is waiting to run, extra copies of straggling runs (with the same seed) are started on the idle threads. The first copy to finish wins, and the others are killed. Extra copies run in their own directory, so any relative path in the cosima source file other than the geometry needs to be made absolute.
+    - `factor` - Multiple of the median run duration after which a run is straggling. Defaults to 1.5.
+    - `copies` - Maximum number of extra copies of a run. Defaults to 1.
+    - `minSamples` - Number of successful runs to observe before starting any copy. Defaults to 5.
+ - `deadline` - If present, the campaign should be done within a wall time budget. Once it is reached, no new job is started, and the campaign exits (with return code 4) once the running ones are done, like `autoMEGA ctl drain`.
+    - `hours` - Wall time budget, from the start of the campaign, in hours. Required.
+    - `coarseToFine` - Flag to queue runs from the coarsest grid of parameter values to the finest (the first and last value of every parameter, then the middle ones, then the quarters, and so on), so the whole parameter space is covered first and the time left refines it. Defaults to on = 1.
+    - `reduce` - Flag to reduce the triggers (or events, or time) of the runs that would not fit otherwise, based on the duration of the successful runs so far. The value given to every run is recorded in the catalog (`timing_value` and `timing_fraction`). Defaults to on = 1.
+    - `minimumFraction` - Smallest fraction of the configured triggers (or events, or time) a run can be reduced to. Defaults to 0.1.
+ - `summary` - If present, the .tra.gz files of every successful run are scanned as soon as revan is done, and the event counts and energy spectrum of every run are recorded in the `summaries` table of the catalog. At the end of the campaign they are written to one tab separated file (one line per run, with its parameter values, see `summaryWrite`):
+    - `filename` - Summary file. Defaults to `summary.tsv`.
+    - `bins` - Number of bins of the energy spectrum. Defaults to 100.
+    - `minimum` - Lower edge of the spectrum, in keV. Defaults to 0.
+    - `maximum` - Upper edge of the spectrum, in keV. Defaults to 10000.
+    - `logarithmic` - Flag to space the bins logarithmically (the minimum must then be positive). Defaults to off = 0.
+ - `scratch` - Node-local scratch directory (eg. `/tmp` or `/dev/shm`) to run simulations in. Only the files left at the end of a run are moved to its results directory. Note that any relative path in the cosima source file other than the geometry needs to be made absolute. (defaults to none)
 General settings files:
  - `revanSettings` - Defaults to system default (`~/revan.cfg`)
  - `slackVerbosity` - Slack verbosity. Level 3 prints all messages, level 2 prints fewer messages, level one prints only error messages, and level zero only prints final messages. Defaults to zero
- - `cosimaVerbosity` - Cosima verbosity. Defaults to zero.
+ - `cosimaVerbosity` - Cosima verbosity. Defaults to zero. The progress of every run (status bar and `autoMEGA ctl status`) follows the trigger and event counters cosima and revan print (lines starting with "trigger" or "event" and the count, eg. `Event 1200`; counts above the triggers, or events, of the run are ignored). Runs that print none only move once cosima is done.
+ - `seed` - Master seed of the campaign. The seed of every run is derived from it and the run number (see `deriveSeed`), so a campaign (or any single run of it) can be reproduced exactly. Defaults to a random seed, recorded in the catalog.
+
+### Results:
+Every run is recorded in `catalog.db`, an sqlite database with one record per run (table `runs`: run and geometry numbers, seed and number of attempts, status, output files, and one column per parameter) and per geometry variant (table `geometries`). The parameter columns are described in table `parameters`. For example, `SELECT tra FROM runs WHERE status='done' AND src_Pos_Beam_1=90` lists the revan outputs of every run with the second element of the `Pos.Beam` parameter set to 90.
 
 Standard parameter format:
 
@@ -872,6 +600,22 @@ If there are three values, then the parameter starts at the first value and incr
 
 If the array is a double array of values, those are taken as the literal values of the parameter.
 
+Reprocess settings (if present, the cosima and geomega settings are ignored, and only revan runs, with the current `revanSettings`, on the .sim.gz files kept by a previous campaign):
+ - `catalog` - Catalog (`catalog.db`) of the previous campaign
+ - `geometry` - Geometry to reprocess with. Optional, if not present each run is reprocessed with the geometry it was simulated with.
+ - `where` - SQL condition on the runs of the previous catalog, to only reprocess some of them (eg. `src_Pos_Beam_1=90`). Optional.
+Runs keep their numbers, seeds and parameter values. Reprocess in a directory of its own (autoMEGA refuses to start in the directory of the previous campaign, or in any directory containing it), so several reconstructions of the same simulations can coexist, each with its own catalog. The kept .sim.gz files are linked, never moved or deleted.
+
+Stages settings (extra steps run after revan, each named by its key; `cosima`, `revan` and `run` are reserved):
+ - `command` - Command template, run with the MEGAlib environment. Its output is saved in `<stage>.run<N>.log.xz` (`<stage>.log.xz` for reduce stages). Placeholders: `{run}`, `{runNumber}`, `{dir}`, `{source}`, `{geometry}`, `{sim}` (empty unless it was kept), `{tra}`, `{seed}`, `{campaign}` and `{catalog}`. Paths are absolute. Values are substituted already quoted (eg. `'run12'`), so placeholders should not be put in quotes again.
+ - `after` - Stages this stage depends on. Defaults to `[revan]`.
+ - `inputs` - Files (templates) that must exist before the stage starts. Optional.
+ - `outputs` - Files (templates) that must exist once the stage is done, otherwise it failed. Optional.
+ - `concurrency` - Maximum number of jobs of this stage running at the same time. Defaults to `maxThreads`.
+ - `timeout` - Seconds after which a job of this stage is killed (and failed). Optional, stages are not timed out by default (the `timeouts` settings only apply to cosima and revan).
+ - `reduce` - If true, the stage runs once, in the campaign directory, after every run and every per run stage is done. Defaults to false. It is skipped if a stage it depends on failed (for any run).
+Per run stages run in the directory of every successful run, as soon as the stages they depend on succeeded for it, before new runs are started. Every job is recorded in the `stages` table of the catalog.
+
 Cosima settings:
  - `filename` - Base cosima .source file
  - `triggers` - Number of triggers to run. Conflicts with "events" and "time". Single value. Optional.
@@ -886,6 +630,8 @@ Cosima settings:
 
 Geomega settings:
  - `filename` - Base geomega .geo.setup file
+ - `overlay` - If true, only the modified files are written for each variant, and everything else is included from the original files. Otherwise every variant is a full merged copy of the geometry. Defaults to false.
+ - `incrementalChecks` - If true, once one variant passed a full overlap check, the other variants are only checked around the volumes their parameter lines alter (and fully if those lines alter the volume hierarchy). Defaults to false.
  - `parameters` - Array of parameters, formatted as such:
     - `filename` - Filename of the file to modify
     - `line number` - line to replace
@@ -894,6 +640,8 @@ Geomega settings:
 ### Dependencies:
  - MEGAlib (Tested on v2.34)
  - yaml-cpp (0.5 or newer)
+ - sqlite3 (development headers, eg. `libsqlite3-dev`)
+ - zlib (development headers, eg. `zlib1g-dev`)
  - g++ with C++11 (Tested on 5.4.1, 7.3.0, and 8.1.1)
     - clang++ may replace g++, but may require modifications to the Makefile (tested on clang++ 6.0.1)
  - sendmail (optional, required only for email functionality)
@@ -907,27 +655,57 @@ make
 Or, manually:
 ```
 g++ checkGeometry.cpp -o checkGeometry -std=c++11 -pthread -lyaml-cpp -O2 -Wall $(root-config --cflags --glibs) -I$MEGALIB/include -L$MEGALIB/lib -lGeomegaGui -lGeomega -lCommonGui -lCommonMisc
-g++ autoMEGA.cpp -o autoMEGA -std=c++11 -pthread -lyaml-cpp -O2 -Wall
+g++ -c libautomega.cpp -o libautomega.o -std=c++11 -pthread -O2 -Wall && ar rcs libautomega.a libautomega.o
+g++ autoMEGA.cpp libautomega.a -o autoMEGA -std=c++11 -pthread -lyaml-cpp -lsqlite3 -lz -O2 -Wall
 ```
 */
 int main(int argc,char** argv){
-    auto start = chrono::steady_clock::now();
-    for(int i=0;i<9;i++) statusBar[i]=0;
+    // Control a running campaign, or run the daemon
+    if(argc>1 && string(argv[1])=="ctl") return controlClient(argc,argv);
+    if(argc>1 && string(argv[1])=="daemon") return daemonMain(argc,argv);
 
     // Parse command line arguments
+    bool plan = 0, quiet = 0, hold = 0;
+    int test = 0, threads = 0;
+    string settings = "config.yaml", history = "catalog.db", socketPath = "", existingFiles = "";
     for(int i=0;i<argc;i++){
         if(i<argc-1) if(string(argv[i])=="--settings") settings = argv[++i];
         if(string(argv[i])=="--test") test = 1;
+        if(string(argv[i])=="--plan") plan = 1;
+        if(i<argc-1) if(string(argv[i])=="--history") history = argv[++i];
+        if(i<argc-1) if(string(argv[i])=="--threads") threads = atoi(argv[++i]);
+        if(i<argc-1) if(string(argv[i])=="--socket") socketPath = argv[++i];
+        if(i<argc-1) if(string(argv[i])=="--existing") existingFiles = argv[++i];
+        if(string(argv[i])=="--quiet") quiet = 1;
+        if(string(argv[i])=="--hold") hold = 1;
+    }
+    if(!existingFiles.empty() && existingFiles!="clean" && existingFiles!="skip" && existingFiles!="exit"){
+        cerr << "MAIN: Unknown --existing option \""+existingFiles+"\" (use clean, skip, or exit). Exiting." << endl;
+        return 1;
     }
 
     // Make sure config file exists
     if(!fileExists(settings)){
-        quickSlack("MAIN: File \"" + settings + "\" does not exist, but was requested. Exiting.");
+        cerr << "MAIN: File \"" + settings + "\" does not exist, but was requested. Exiting." << endl;
         return 1;
     }
 
-    // Check directory
-    if(directoryEmpty(".")) return 3;
+    // Parse config file into the campaign, which runs in the current directory
+    automega::campaign campaign(".");
+    try {
+        campaign.configure(YAML::LoadFile(settings),absolutePath(settings));
+    } catch(const YAML::Exception& error){
+        cerr << "MAIN: Could not parse \""+settings+"\": "+error.what()+". Exiting." << endl;
+        return 1;
+    }
+    if(!socketPath.empty()) campaign.setting("controlSocket",socketPath);
+    campaign.existing(existingFiles);
+    campaign.quiet(quiet);
+    campaign.test(test);
+
+    // Only print the size of the campaign
+    if(plan) return campaign.plan(history);
+    if(hold) campaign.control("pause");
 
     // Disable echo
     struct termios tty;
@@ -935,90 +713,29 @@ int main(int argc,char** argv){
     tty.c_lflag &= ~ECHO;
     (void) tcsetattr(STDIN_FILENO, TCSANOW, &tty);
 
-    // Parse config file
-    YAML::Node config = YAML::LoadFile(settings);
-    if(config["address"]) address = config["address"].as<string>();
-    if(config["token"]) token = config["token"].as<string>();
-    if(config["channel"]) channel = config["channel"].as<string>();
-    if(config["keepAll"]) keepAll = config["keepAll"].as<bool>();
-    if(config["slackVerbosity"]) slackVerbosity = config["slackVerbosity"].as<int>();
-    if(config["cosimaVerbosity"]) cosimaVerbosity = config["cosimaVerbosity"].as<int>();
-    if(config["revanSettings"]) revanSettings = config["revanSettings"].as<string>();
-    if(config["maxThreads"]) maxThreads = config["maxThreads"].as<int>();
-
-    // Create threadpool
-    vector<thread> threadpool;
-    cout << "Using "+to_string(maxThreads)+" threads.\nTo pause:\nkill -STOP -"+to_string(getpid())+"\nTo continue:\nkill -CONT -"+to_string(getpid())+"\n" << endl;
-    legend.open("run.legend");
-
-    // Start watchdog thread(s)
-    thread watchdog0(storageWatchdog,2000);
-
-    // Start status thread
-    thread statusThread(handleStatus);
-
-    // Geomega stage
-    quickSlack("Starting Geomega stage.",3);
-    vector<string> geometries;
-    if(config["geomega"] && geomegaSetup(config["geomega"],geometries)!=0){
-        // Close threads
-        exitFlag=1;
-        watchdog0.join();
-        statusThread.join();
-        for(size_t i=0;i<threadpool.size();i++) threadpool[i].join();
-        legend.close();
-
-        // Enable echo
-        tcgetattr(STDIN_FILENO, &tty);
-        tty.c_lflag |= ECHO;
-        (void) tcsetattr(STDIN_FILENO, TCSANOW, &tty);
-        return 2;
-    }
-
-    // Cosima stage
-    quickSlack("Starting Cosima parsing stage",3);
-    vector<string> sources;
-    if(config["cosima"]) if(cosimaSetup(config["cosima"],sources,geometries)!=0){
-        // Close threads
-        exitFlag=1;
-        watchdog0.join();
-        statusThread.join();
-        for(size_t i=0;i<threadpool.size();i++) threadpool[i].join();
-        legend.close();
-
-        // Enable echo
-        tcgetattr(STDIN_FILENO, &tty);
-        tty.c_lflag |= ECHO;
-        (void) tcsetattr(STDIN_FILENO, TCSANOW, &tty);
-        return 3;
-    }
-
-    // Calculate total number of simulations
-    quickSlack("Starting simulations",3);
-
-    // Start all simulation threads.
-    for(size_t i=0;i<sources.size();i++){
-        while(currentThreadCount>=maxThreads) usleep(100000);
-        threadpool.push_back(thread(runSimulation,sources[i],threadpool.size()));
-        currentThreadCount++;
+    // Jobs run in their own process groups, so pausing and interrupting is forwarded to them by the campaign
+    signal(SIGUSR1,[](int){ paused = 1; });
+    signal(SIGUSR2,[](int){ paused = 0; });
+    signal(SIGINT,[](int sig){ interrupted = 1; signal(sig,SIG_DFL); });
+    signal(SIGTERM,[](int sig){ interrupted = 1; signal(sig,SIG_DFL); });
+    if(!quiet) cout << "To pause:\nkill -USR1 "+to_string(getpid())+"\nTo continue:\nkill -USR2 "+to_string(getpid())+"\n" << endl;
+
+    // Run the campaign, forwarding signals to it
+    campaign.submit(threads);
+    bool suspended = 0, cancelled = 0;
+    while(campaign.running()){
+        if(interrupted && !cancelled) cancelled = !campaign.cancel();
+        if(paused!=suspended){
+            suspended = paused;
+            campaign.control(suspended?"suspend":"resume");
+        }
+        usleep(100000);
     }
-    // Join simulation threads
-    for(size_t i=0;i<threadpool.size();i++) threadpool[i].join();
-    legend.close();
+    int status = campaign.wait();
 
     // Enable echo
     tcgetattr(STDIN_FILENO, &tty);
     tty.c_lflag |= ECHO;
     (void) tcsetattr(STDIN_FILENO, TCSANOW, &tty);
-
-    // Close threads
-    exitFlag=1;
-    watchdog0.join();
-    statusThread.join();
-
-    // End timer, print command duration
-    auto end = chrono::steady_clock::now();
-    quickSlack("Simulation complete. Elapsed time: "+beautify_duration(chrono::duration_cast<chrono::seconds>(end-start)));
-    if(!address.empty()) email(address,"Simulation Complete. Elapsed time: "+beautify_duration(chrono::duration_cast<chrono::seconds>(end-start)));
-    return 0;
+    return status;
 }
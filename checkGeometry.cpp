@@ -3,6 +3,8 @@
 #include <iomanip>
 #include <string>
 #include <vector>
+#include <set>
+#include <sstream>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <libgen.h>
@@ -16,6 +18,9 @@ using namespace std;
 #include <TEnv.h>
 #include <MString.h>
 #include <TSystem.h>
+#include <TGeoManager.h>
+#include <TGeoVolume.h>
+#include <TGeoNode.h>
 #include "MInterfaceGeomega.h"
 
 
@@ -53,6 +58,70 @@ public:
     */
     bool SetGeometry(MString FileName, bool UpdateGui = true) { return m_Data->SetCurrentFileName(FileName); }
 
+    /**
+ @brief Find the volumes described by the changed lines
+
+ ## Find the volumes described by the changed lines
+
+ ### Arguments
+ - `std::string changedFile` - File with one changed line per line (as written by autoMEGA)
+ - `std::set<std::string>& volumes` - Names of the volumes the lines describe (return by reference)
+
+ ### Notes
+ Returns 0 if the changes may alter the volume hierarchy, or anything else than a volume, material, or detector (eg. constants or loops), in which case a full check is needed. Returns 1 otherwise. Must be called after ReadGeometry.
+    */
+    bool AffectedVolumes(std::string changedFile, std::set<std::string>& volumes){
+        ifstream in(changedFile);
+        if(!in.is_open()) return 0;
+        for(string line;getline(in,line);){
+            stringstream ss(line);
+            string command; ss >> command;
+            if(command.empty() || command.compare(0,2,"//")==0) continue;
+            size_t dot = command.find('.');
+            if(dot==string::npos || dot==0) return 0;
+            string name = command.substr(0,dot), keyword = command.substr(dot+1);
+            if(keyword=="Mother" || keyword=="Copy") return 0;
+            if(m_Geometry->GetVolume(name)!=0) volumes.insert(name);
+            else if(m_Geometry->GetMaterial(name)==0 && m_Geometry->GetDetector(name)==0) return 0;
+        }
+        return 1;
+    }
+
+    /**
+ @brief Check the given volumes and their neighbours for overlaps
+
+ ## Check the given volumes and their neighbours for overlaps
+
+ ### Arguments
+ - `const std::set<std::string>& volumes` - Names of the volumes to check
+
+ ### Notes
+ Returns 1 if there is an overlap, returns 0 otherwise. Every volume containing one of the volumes (or a copy of it) is checked, which covers its siblings and its extrusion out of its mother, as is every one of the volumes itself, which covers its own daughters. Each of them gets both the ROOT overlap check and a sampling check similar to the one of cosima.
+    */
+    bool TestVolumes(const std::set<std::string>& volumes){
+        if(gGeoManager==0) m_Geometry->DrawGeometry();
+        if(gGeoManager==0) return 1;
+        auto affected = [&volumes](string name){
+            if(volumes.count(name)) return true;
+            size_t copy = name.find_last_of('_');
+            return copy!=string::npos && name.find_first_not_of("0123456789",copy+1)==string::npos && volumes.count(name.substr(0,copy))>0;
+        };
+
+        gGeoManager->ClearOverlaps();
+        TIter next(gGeoManager->GetListOfVolumes());
+        while(TGeoVolume* volume = (TGeoVolume*)next()){
+            bool check = affected(volume->GetName());
+            for(int i=0;i<volume->GetNdaughters() && !check;i++){
+                TGeoNode* node = volume->GetNode(i);
+                check = affected(node->GetName()) || affected(node->GetVolume()->GetName());
+            }
+            if(!check) continue;
+            volume->CheckOverlaps(0.0001);
+            volume->CheckOverlaps(0.0001,"s10000");
+        }
+        return gGeoManager->GetListOfOverlaps()->GetEntriesFast()>0;
+    }
+
     /**
  @brief Check geometry for overlaps
 
@@ -60,13 +129,19 @@ public:
 
  ### Arguments
  - `std::string outputFile` - Temp file to write cosima warnings to
+ - `std::string changedFile` - Lines altered since a variant that passed a full check (optional)
 
  ### Notes
  Returns 1 if there is an overlap, returns 0 otherwise. If cosima cannot be found or files cannot be created for a test, then that test may be skipped.
+
+ If `changedFile` is given, and the changed lines only alter volumes (see AffectedVolumes), only those volumes and their neighbours are checked (see TestVolumes). Otherwise the whole geometry is checked.
     */
-    bool TestIntersections(std::string outputFile){
+    bool TestIntersections(std::string outputFile, std::string changedFile=""){
         if(!ReadGeometry()) return 1;
 
+        std::set<std::string> volumes;
+        if(!changedFile.empty() && AffectedVolumes(changedFile,volumes)) return TestVolumes(volumes);
+
         bool status = m_Geometry->CheckOverlaps();
         if(!status) return 1;
 
@@ -101,6 +176,8 @@ public:
 All arguments are parsed as filenames to be checked, and the program returns the total number of invalid geometries
 Returns the total number of invalid geometries
 
+`--changed <file>` (before the filenames) restricts the checks to the volumes described by the lines in that file, as long as the rest of the geometry already passed a full check (see TestIntersections)
+
 ### To build:
 ```
 g++ checkGeometry.cpp -o checkGeometry -std=c++11 -pthread -O2 -Wall $(root-config --cflags --libs) -I$MEGALIB/include -L$MEGALIB/lib -lGeomegaGui -lGeomega -lCommonGui -lCommonMisc
@@ -117,10 +194,15 @@ int main(int argc,char** argv){
     gErrorIgnoreLevel = kFatal;
 
     // Check each geometry, return number of failures
+    string changed;
     for(int i=1;i<argc;i++){
+        if(string(argv[i])=="--changed" && i+1<argc){
+            changed = argv[++i];
+            continue;
+        }
         aMInterfaceGeomega geomega;
         geomega.SetGeometry(argv[i]);
-        bool good = geomega.TestIntersections(string(argv[i])+".out");
+        bool good = geomega.TestIntersections(string(argv[i])+".out",changed);
         overall +=good;
     }
 
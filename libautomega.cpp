@@ -0,0 +1,5566 @@
+/**
+    libautomega
+    Runs autoMEGA campaigns in-process: build a parameter space, submit it, and get every run as soon as it is done.
+    The campaign engine lives here. The autoMEGA command line parses its settings file into an `automega::campaign`.
+
+    @author Connor Bray
+*/
+
+#include "libautomega.h"
+#include "yaml-cpp/yaml.h"
+#include <sqlite3.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <deque>
+#include <regex>
+#include <thread>
+#include <ctime>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/statvfs.h>
+#include <glob.h>
+#include <dirent.h>
+#include <cerrno>
+#include <tuple>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <cmath>
+#include <functional>
+#include <set>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <condition_variable>
+#include <zlib.h>
+
+using namespace std;
+
+namespace automega {
+
+/**
+ @brief One dimension of the parameter space
+
+ ## One dimension of the parameter space
+
+ ### Notes
+ Describes one geomega or cosima parameter, as parsed by `parseIterativeNode`. Used to record the parameters of every run in the catalog.
+*/
+struct parameter {
+    /// Name of the parameter (YAML key for geomega, `<Source>.<Keyword>` for cosima)
+    string name;
+    /// Catalog column holding the full value
+    string column;
+    /// Full value of every option
+    vector<string> options;
+    /// Value of each element, for every option
+    vector<vector<string>> elements;
+    /// Whether each element was given as a numeric range
+    vector<bool> numeric;
+    /// Whether each element takes more than one value (and gets its own catalog column)
+    vector<bool> varying;
+    /// File and line altered (geomega only)
+    string file;
+    int line = 0;
+};
+
+
+/**
+ @brief Set of logical CPUs jobs are pinned to
+
+ ## Set of logical CPUs jobs are pinned to
+
+ ### Notes
+ Built by `placementSetup` from whole physical cores (with all of their hyperthreads) of a single NUMA node.
+*/
+struct placementSlot {
+    /// Logical CPUs of the slot
+    vector<int> cpus;
+    /// NUMA node the CPUs belong to
+    int node = 0;
+    /// Number of jobs currently pinned to the slot
+    int jobs = 0;
+};
+
+
+/**
+ @brief Shared state of the copies of a run
+
+ ## Shared state of the copies of a run
+
+ ### Notes
+ A run is normally executed by a single copy. Once nothing else is waiting, extra (speculative) copies of straggling runs may be started, all with the seed of the current attempt. The first copy to succeed wins and the others are killed. `running`, `copies`, `cleaning` and `started` are protected by `inflightLock`.
+*/
+struct runState {
+    /// Cosima source file
+    string source;
+    /// Geometry file
+    string geometry;
+    /// Simulation to reprocess (only when reprocessing)
+    string sim;
+    /// Run number
+    int run = 0;
+    /// Seed of the current attempt
+    atomic<uint32_t> seed{0};
+    /// Copy that won the current attempt, or -1
+    atomic<int> winner{-1};
+    /// Bool to kill every copy of the current attempt
+    atomic<bool> cancel{false};
+    /// Bool set if the current attempt is the last one
+    atomic<bool> last{false};
+    /// Bool set if the .sim.gz file of the run was kept
+    atomic<bool> keptSim{false};
+    /// Fraction of the configured triggers (or events, or time) the run was given (see `budgetRun`)
+    double fraction = 1;
+    /// Triggers (or events) the run has to simulate, or 0 if it is not known (eg. runs given a time)
+    long long target = 0;
+    /// Events simulated by cosima and analysed by revan in the current attempt, as last printed by the most advanced copy (see `readProgress`)
+    atomic<long long> simulated{0}, analysed{0};
+    /// Bool set once cosima succeeded in the current attempt
+    atomic<bool> simulatedAll{false};
+    /// Seconds the winning copy took to print its first count (loading the geometry, see `runCommand`), or -1
+    double setup = -1;
+    /// Size of the .sim.gz and .tra.gz files of the run (-1 if there are none)
+    long long simBytes = -1, traBytes = -1;
+    /// Number of copies of the current attempt still running
+    int running = 0;
+    /// Number of copies started for the current attempt
+    int copies = 0;
+    /// Number of losing copies still removing their outputs
+    int cleaning = 0;
+    /// Start of the current attempt
+    chrono::steady_clock::time_point started;
+};
+
+
+/**
+ @brief Step of the pipeline, after revan
+
+ ## Step of the pipeline, after revan
+
+ ### Notes
+ Parsed from the `stages` section by `stagesSetup`. Per run stages run in the directory of every successful run, once the stages they depend on succeeded for that run. Reduce stages run once, in the campaign directory, once every run and every per run stage is done. `queue`, `running`, `done`, `failed` and `state` are protected by `stageLock`.
+*/
+struct pipelineStage {
+    /// Stage name
+    string name;
+    /// Command template (see `stageExpand`)
+    string command;
+    /// Stages this stage depends on ("cosima" and "revan" are the built in stages)
+    vector<string> after;
+    /// Indexes (in `stages`) of the stages this stage depends on, without the built in stages
+    vector<int> dependencies;
+    /// Files (templates) that must exist before the stage starts
+    vector<string> inputs;
+    /// Files (templates) that must exist once the stage succeeded
+    vector<string> outputs;
+    /// Maximum number of jobs of this stage running at the same time
+    int concurrency = INT_MAX;
+    /// Seconds after which a job of this stage is killed (0 for no timeout)
+    double timeout = 0;
+    /// Bool set for reduce stages
+    bool reduce = 0;
+    /// Runs waiting for this stage (per run stages only)
+    deque<int> queue;
+    /// Number of jobs running, succeeded, and failed
+    int running = 0, done = 0, failed = 0;
+    /// State of a reduce stage: 0 waiting, 1 running, 2 succeeded, 3 failed or skipped
+    int state = 0;
+};
+
+
+/**
+ @brief Progress of the stages of one run
+
+ ## Progress of the stages of one run
+*/
+struct stageProgress {
+    /// Values of the placeholders of the command templates
+    map<string,string> values;
+    /// Status of every stage: 0 waiting, 1 queued or running, 2 succeeded, 3 failed
+    vector<char> status;
+    /// Number of stages queued or running
+    int active = 0;
+};
+
+
+/**
+ @brief Counters and energy spectrum of the revan output of a run
+
+ ## Counters and energy spectrum of the revan output of a run
+
+ ### Notes
+ Filled by `traScan`. Energies are the total energy of each event: `CE` (both energies) for Compton events, `PE` for photo events, and `PE` plus `PP` (electron and positron) for pair events. Other event types are only counted.
+*/
+struct traSummary {
+    /// Number of events
+    long long events = 0;
+    /// Number of events of every type (`ET`)
+    map<string,long long> types;
+    /// Number of events of every bad event flag (`BD`)
+    map<string,long long> flags;
+    /// Energy spectrum, with the underflow first and the overflow last
+    vector<long long> spectrum;
+};
+
+
+
+struct geoTree;
+struct geomegaParameters;
+
+
+/**
+ @brief State of one campaign
+
+ ## State of one campaign
+
+ ### Notes
+ Everything a campaign uses, so several campaigns can run side by side in one process without sharing anything. Its stages are member functions, documented where they are defined. Every thread of the campaign is started (directly or not) from `worker`, after `enter`, so it runs in the campaign directory.
+*/
+struct campaign::engine {
+    /// Revan settings file (defaults to revan default)
+    string revanSettings = "~/.revan.cfg";
+    /// Slack hook (if empty, slack notifications are disabled)
+    string token = "";
+    /// Slack channel
+    string channel = "";
+    /// Email address for notifications (if empty, email notifications are disabled)
+    string address = "";
+    /// Maximum threads to use for simulations (defaults to system thread count)
+    atomic<int> maxThreads{(std::thread::hardware_concurrency()==0)?4:(int)std::thread::hardware_concurrency()}; // If it cannot detect the number of threads, default to 4
+    /// Results catalog (sqlite database)
+    sqlite3* catalog = NULL;
+    /// SQL statements waiting to be written to the catalog by catalogWriter
+    deque<string> catalogQueue;
+    /// Mutex to make sure only one thing is writing to catalogQueue at a time
+    mutex catalogLock;
+    /// Bool to tell catalogWriter to exit once its queue is empty
+    atomic<bool> catalogDone{false};
+    /// Geomega parameters, first parameter varying slowest
+    vector<parameter> geometryParameters;
+    /// Cosima parameters, first parameter varying fastest
+    vector<parameter> sourceParameters;
+    /// Current thread count
+    atomic<int> currentThreadCount{0};
+    /// Int to indicate test level (0=real run, otherwise it disables some exiting or notification features)
+    atomic<int> test{0};
+    /// Bool to indicate what files to keep (false = keep no intermediary files, true = keep all)
+    atomic<bool> keepAll{false};
+    /// Int to indicate slack verbosity level. Level 3 prints all messages, level 2 prints fewer messages, level one prints only error messages, and level zero only prints final messages. Defaults to zero
+    atomic<int> slackVerbosity{0};
+    /// Retention policy for .sim.gz files: "none", "all", "failed", "first" or "pressure" (keepAll implies "all")
+    string simRetention = "none";
+    /// Number of .sim.gz files to keep per geometry variant, for the "first" retention policy
+    atomic<int> keepFirst{1};
+    /// Free storage (in MB) below which kept .sim.gz files are deleted, oldest first, for the "pressure" retention policy
+    atomic<double> pressureMB{20000};
+    /// Kept .sim.gz files, oldest first, as (run number, filename) (only used by the "pressure" retention policy)
+    deque<pair<int,string>> keptSimulations;
+    /// Number of .sim.gz files kept per geometry variant (only used by the "first" retention policy)
+    map<int,int> keptPerGeometry;
+    /// Mutex to protect keptSimulations and keptPerGeometry
+    mutex retentionLock;
+    /// Number of background cleanup threads
+    int cleanupThreads = 8;
+    /// Files waiting to be deleted in the background, as (directory descriptor, name). If the descriptor is null, the name is a pattern relative to the current directory
+    deque<pair<shared_ptr<int>,string>> cleanupQueue;
+    /// Mutex to protect cleanupQueue
+    mutex cleanupLock;
+    /// Number of files queued for deletion and not yet deleted
+    atomic<int> cleanupPending{0};
+    /// Bool to stream cosima output straight into revan through a named pipe (only used if no .sim.gz files are kept)
+    atomic<bool> stream{false};
+    /// Bool to run each simulation in its own sharded directory (runs/<run/100>/<run%100>/)
+    atomic<bool> runDirectories{false};
+    /// Node-local scratch directory to run simulations in (if empty, simulations run where their results are kept)
+    string scratch = "";
+    /// Int to indicate cosima verbosity level. Defaults to zero
+    atomic<int> cosimaVerbosity{0};
+    /// Array to store current state for status bar
+    atomic<int> statusBar[9];
+    /// Running average of simulation length
+    chrono::seconds averageTime{0};
+    /// semaphore for average time
+    mutex timeLock;
+    /// Running average of the share of cosima in the duration of the cosima and revan stages
+    atomic<double> cosimaShare{0.5};
+    /// Events simulated by the attempts no longer in flight
+    atomic<long long> eventsFinished{0};
+    /// Time (in seconds of the steady clock) the first run started, or 0
+    atomic<double> runsStarted{0};
+    /// Bool to read the files of a geometry variant into the page cache before its runs start (see `warmGeometry`)
+    atomic<bool> warmGeometries{false};
+    /// Files of every geometry warmed so far (the setup file and every file it includes), by absolute path of the setup file
+    map<string,vector<string>> warmFiles;
+    /// Mutex to protect warmFiles
+    mutex warmLock;
+    /// Recent samples of the number of events simulated, as (time in seconds of the steady clock, events), for `eventRate`
+    deque<pair<double,long long>> eventSamples;
+    /// Mutex to protect eventSamples
+    mutex eventLock;
+    /// Bool to tell external threads to exit
+    std::atomic<bool> exitFlag{false};
+    /// Master seed of the campaign, from which every run seed is derived
+    atomic<uint64_t> masterSeed{0};
+    /// Number of geometry variants (runs are numbered with the geometry varying fastest)
+    atomic<int> geometryCount{1};
+    /// Cosima sources with every parameter except the geometry applied
+    vector<string> sourceTemplates;
+    /// Timing keyword (Triggers, Events, or Time) and value applied to every source
+    string sourceTiming[2] = {"",""};
+    /// Geometry variants waiting to be checked, as (filename, geometry index)
+    deque<pair<string,int>> checkQueue;
+    /// Runs waiting to be simulated, as (source, run number)
+    deque<pair<string,int>> runQueue;
+    /// Geometry file of every variant whose runs were written, by geometry index (protected by queueLock)
+    map<int,string> geometryFiles;
+    /// Mutex to protect checkQueue and runQueue
+    mutex queueLock;
+    /// Bool set once every geometry variant has been generated
+    atomic<bool> geometryDone{false};
+    /// Return value of geomegaSetup
+    atomic<int> geometryStatus{0};
+    /// Bool to only check the volumes altered by a variant for overlaps, once another variant passed a full check
+    atomic<bool> incrementalChecks{false};
+    /// Index of the first geometry variant to pass a full check (-1 until then)
+    atomic<int> referenceGeometry{-1};
+    /// Bool to pin every job to its own set of cores, and bind its memory to their NUMA node
+    atomic<bool> placement{false};
+    /// Bool to bind the memory of every job to the NUMA node of its cores (only used with placement)
+    atomic<bool> bindMemory{true};
+    /// Core sets jobs are pinned to
+    vector<placementSlot> placementSlots;
+    /// Logical CPUs reserved for helper processes (eg. xz), as a list for taskset (if empty, helpers are not pinned)
+    string helperCPUs = "";
+    /// Mutex to protect placementSlots
+    mutex placementLock;
+    /// Maximum number of times a failed run is retried, each time with a new seed
+    atomic<int> retries{2};
+    /// Bool to kill stages that take much longer than usual
+    atomic<bool> timeouts{false};
+    /// Percentile (of the durations of successful stages) timeouts are based on
+    atomic<double> timeoutPercentile{95};
+    /// Multiple of that percentile after which a stage is killed
+    atomic<double> timeoutFactor{3};
+    /// Shortest timeout, in seconds
+    atomic<double> timeoutMinimum{600};
+    /// Number of successful stages to observe before any stage is timed out
+    atomic<int> timeoutSamples{10};
+    /// Durations (in seconds) of successful stages ("cosima", "revan", "run" for whole attempts, "full" for whole attempts scaled to the configured triggers, and "setup" for the time before the first event)
+    map<string,vector<double>> stageDurations;
+    /// Mutex to protect stageDurations
+    mutex durationLock;
+    /// Bool to start extra copies of straggling runs once nothing else is waiting
+    atomic<bool> speculation{false};
+    /// Multiple of the median run duration after which a run is a straggler
+    atomic<double> speculationFactor{1.5};
+    /// Maximum number of extra copies of each run
+    atomic<int> speculationCopies{1};
+    /// Number of successful runs to observe before any copy is started
+    atomic<int> speculationSamples{5};
+    /// Runs in progress, by run number
+    map<int,shared_ptr<runState>> runsInFlight;
+    /// Mutex to protect runsInFlight (and the shared counters of every runState)
+    mutex inflightLock;
+    /// Bool set while jobs are paused (SIGUSR1 pauses, SIGUSR2 continues)
+    atomic<bool> paused{false};
+    /// Bool set on SIGINT or SIGTERM, to kill running jobs and stop starting new ones
+    atomic<bool> interrupted{false};
+    /// Bool set while no new job is started, without pausing the running ones (see `autoMEGA ctl pause`)
+    atomic<bool> holding{false};
+    /// Bool set to stop starting new jobs, and exit once the running ones are done (see `autoMEGA ctl drain`)
+    atomic<bool> draining{false};
+    /// Unix domain socket accepting control commands (see `serve`)
+    string controlSocket = "autoMEGA.sock";
+    /// What to do with files already in the campaign directory: "clean", "skip", or "" to ask
+    string existingFiles = "";
+    /// Bool to not print the status bar (eg. for campaigns run by the daemon)
+    atomic<bool> quiet{false};
+    /// Catalog of the campaign whose simulations are reprocessed (if empty, simulations are run as usual)
+    string reprocessCatalog = "";
+    /// Geometry to reprocess the simulations with (if empty, each run keeps the geometry it was simulated with)
+    string reprocessGeometry = "";
+    /// Simulations to reprocess, by run number, as (.sim.gz file, geometry file)
+    map<int,pair<string,string>> reprocessRuns;
+    /// Stages run after revan, in the order they were given
+    vector<pipelineStage> stages;
+    /// Stage progress of the runs that still have stages queued or running, by run number
+    map<int,stageProgress> stageRuns;
+    /// Mutex to protect stages and stageRuns
+    mutex stageLock;
+    /// Number of stage jobs running
+    atomic<int> stageJobsRunning{0};
+    /// Bool to summarise the .tra.gz files of every successful run (see `traScan`)
+    atomic<bool> summarise{false};
+    /// Summary file written at the end of the campaign
+    string summaryFile = "summary.tsv";
+    /// Number of bins, and range (in keV), of the energy spectrum of the summary
+    atomic<int> summaryBins{100};
+    atomic<double> summaryMinimum{0}, summaryMaximum{10000};
+    /// Bool to space the bins of the energy spectrum logarithmically
+    atomic<bool> summaryLogarithmic{false};
+    /// Time (since the epoch) by which the campaign should be done, or 0 for no deadline
+    atomic<long long> deadlineTime{0};
+    /// Bool to queue runs from the coarsest grid of parameter values to the finest (only with a deadline)
+    atomic<bool> deadlineOrder{true};
+    /// Bool to reduce the triggers (or events, or time) of runs that would not fit before the deadline
+    atomic<bool> deadlineReduce{true};
+    /// Smallest fraction of the configured triggers (or events, or time) a run can be reduced to
+    atomic<double> deadlineMinimum{0.1};
+    /// Fraction given to the last run started (see `deadlineFraction`)
+    atomic<double> deadlineLast{1};
+
+    /// Settings file of the campaign (absolute path, empty if it was configured by another program)
+    string settings = "";
+    /// Campaign directory (absolute path)
+    string directory;
+    /// Configuration of the campaign, in the format of the settings file
+    YAML::Node config;
+    /// checkGeometry executable (defaults to the one next to the running program, or else the one in the PATH)
+    string checkGeometry = "";
+    /// Directory (under `scratch`) this campaign runs simulations in (see `scratchDirectory`)
+    string scratchRun = "";
+    /// Threads given to `submit` (if 0, `maxThreads` is used)
+    int threads = 0;
+    /// Physical cores per core set, and reserved for helper processes (see `placementSetup`)
+    int coresPerJob = 1, helperCores = 1;
+    /// Bool set if the campaign has geometry variants
+    bool geomega = false;
+    /// Functions called for every finished run, once the campaign is done, and for every message
+    function<void(const run&)> runCallback;
+    function<void(int)> doneCallback;
+    function<void(const string&)> messageCallback;
+    /// Finished runs, in the order they finished
+    vector<run> finished;
+    /// Mutex to protect finished, and to call runCallback from one thread at a time
+    mutex reportLock;
+    /// Geometry and parameter values of the reprocessed runs, by run number (see `reprocessQueue`)
+    map<int,run> reprocessed;
+    /// Thread running the campaign (see `submit`)
+    thread worker;
+    /// Return code of the campaign (-1 while it runs)
+    atomic<int> exitCode{-1};
+    /// Bool set once the campaign was submitted
+    atomic<bool> started{false};
+
+    engine(string directory);
+    bool enter();
+    int setup();
+    int execute();
+    void work();
+    void reportRun(int runNumber, bool failed, int attempts, string tra);
+
+    // Stages of the campaign
+
+    uint32_t deriveSeed(uint64_t runNumber, uint64_t stream=0);
+    void cleanupPost(std::string file, shared_ptr<int> directory=shared_ptr<int>());
+    void cleanupWorker();
+    void cleanupWait();
+    void wipeDirectory(std::string dir, std::string keep="");
+    bool directoryEmpty(std::string dir);
+    void storageWatchdog(double MB);
+    string runDirectory(int runNumber);
+    string scratchDirectory();
+    double runCompletion(runState& state);
+    void campaignProgress(double& runs, long long& events, vector<pair<int,double>>* completion=NULL);
+    double campaignEta(double runs);
+    double eventRate(long long events);
+    void handleStatus();
+    void quickSlack(string message,int verbosity=0);
+    int placementSetup(int coresPerJob, int helperCores);
+    int placementAcquire();
+    void placementRelease(int slot);
+    int runCommand(string command, double timeout=0, atomic<bool>* cancel=NULL, double* duration=NULL, atomic<long long>* progress=NULL, double* setup=NULL, long long limit=0);
+    vector<string> parseIterativeNode(YAML::Node contents, std::string prepend="", vector<vector<string>>* elements=NULL, vector<bool>* numeric=NULL);
+    void catalogPost(string statement);
+    void catalogWriter();
+    bool catalogOpen(string filename);
+    int geoLoad(string inputFile, string reference, geoTree& tree);
+    int geoMerge(string inputFile, ostream& out, geoTree& tree);
+    int geoOverlay(geoTree& tree, map<size_t,map<size_t,string>>& changes, string prefix);
+    int runLevel(int runNumber);
+    void queueRun(string source, int runNumber);
+    void writeSources(string geometry, int geometryIndex);
+    bool writeChanges(string filename, int geometryIndex, int reference);
+    void testGeometry(string filename, int geometryIndex);
+    int geomegaParse(YAML::Node geomega, geomegaParameters& parameters);
+    void queueGeometry(string filename, int geometryIndex);
+    int geoLocate(const string& merged, const vector<size_t>& mergedLines, vector<string>& files, vector<int>& lines, map<size_t,size_t>& targets);
+    int geomegaSetup(geomegaParameters& parameters);
+    int cosimaSetup(YAML::Node cosima, bool templates=1);
+    int reprocessSetup(YAML::Node reprocess);
+    bool reprocessQueue(YAML::Node reprocess);
+    int stagesSetup(YAML::Node node);
+    bool retainSimulation(int runNumber, bool failed, string simFile);
+    void retentionWatchdog();
+    void recordDuration(string stage, double seconds);
+    double stagePercentile(string stage, double percentile, int minSamples);
+    double stageTimeout(string stage);
+    double deadlineFraction();
+    double budgetRun(string source, int runNumber);
+    int stageResult(int status, string stage, int runNumber, double timeout);
+    string megalibCommand(string program, string log, string dir=".", bool tap=false);
+    void stageCommands(string source, string geometry, int runNumber, uint32_t seed, string dir, string& cosima, string& revan, bool tap);
+    int streamSimulation(string cosimaCommand, string revanCommand, string fifo, runState& state, double* setup=NULL);
+    int runStages(runState& state, string dir, double* setup=NULL);
+    string copyDirectory(int runNumber, int copy);
+    void finishCopy(runState& state, string dir, bool failed);
+    void clearCopy(int runNumber, string dir);
+    void runCopy(runState& state, int copy);
+    shared_ptr<runState> findStraggler(int& copy);
+    void speculateRun(shared_ptr<runState> state, int copy);
+    void stageRelease(int runNumber);
+    void stageRunDone(int runNumber, map<string,string> values);
+    int nextStageJob(int& runNumber);
+    int nextReduceStage();
+    bool stagesIdle();
+    void runStage(int stageIndex, int runNumber);
+    int summaryBin(double energy);
+    double summaryEdge(int bin);
+    bool traScan(string filename, traSummary& summary);
+    void summariseRun(int runNumber, string prefix);
+    bool summaryWrite(string filename);
+    string runGeometry(int runNumber);
+    void warmGeometry(string geometry);
+    void runSimulation(const string source, const int threadNumber);
+    string controlCommand(string request);
+    int planCampaign(YAML::Node config, string history);
+};
+typedef campaign::engine engine;
+
+
+/**
+ @brief Generates a random seed from /dev/random or /dev/urandom
+
+ ## Generate a random seed from /dev/random or /dev/urandom
+
+ Generating the seed from /dev/random (or even /dev/urandom) is prefered to generating the seed from the current time because it allows you to start more than one simulation in a second and because /dev/random and /dev/urandom are more random than the current time, and /dev/random is cryptographically secure.
+
+ ### Arguments
+ * `bool uRandom` - Use /dev/urandom instead of /dev/random. Defaults to /dev/urandom, which never blocks
+
+ ### Notes
+ Only used once per campaign, to draw the master seed if none is given. If the device cannot be read after a few attempts, falls back to the current time and process ID.
+
+ Code adapted from that posted by `posop` on stackoverflow
+*/
+template<typename T>
+T random_seed(bool uRandom=1){
+    for(int attempt=0;attempt<10;attempt++){
+        std::ifstream file(uRandom?"/dev/urandom":"/dev/random",std::ios::binary);
+        if(!file.is_open()){ usleep(10000); continue; }
+        T seed;
+        if(file.read(reinterpret_cast<char*>(&seed),sizeof(T))) return seed;
+    }
+    return (T) (chrono::high_resolution_clock::now().time_since_epoch().count()^((long long) getpid()<<32));
+}
+
+
+/**
+ @brief SplitMix64 mixing function
+
+ ## SplitMix64 mixing function
+
+ ### Notes
+ Bijective, so distinct inputs always give distinct outputs. See Steele, Lea and Flood, "Fast splittable pseudorandom number generators" (2014).
+*/
+inline uint64_t splitmix64(uint64_t x){
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x^(x>>30))*0xBF58476D1CE4E5B9ULL;
+    x = (x^(x>>27))*0x94D049BB133111EBULL;
+    return x^(x>>31);
+}
+
+
+/**
+ @brief Derive the seed of a run from the master seed
+
+ ## Derive the seed of a run from the master seed
+
+ ### Arguments
+ * `uint64_t runNumber` - Run number
+ * `uint64_t stream` - Independent stream for the same run (eg. the attempt number). Defaults to 0
+
+ ### Notes
+ Counter-based: the seed only depends on `masterSeed`, the run number and the stream, so any run can be reproduced from the master seed in the catalog, without touching /dev/random. Seeds are positive 31 bit integers, so cosima parses them the same way everywhere.
+*/
+uint32_t engine::deriveSeed(uint64_t runNumber, uint64_t stream){
+    uint32_t seed = splitmix64(splitmix64(splitmix64(masterSeed)^runNumber)^stream)&0x7FFFFFFF;
+    return (seed==0)?1:seed;
+}
+
+
+/**
+ @brief Removes a file, after expanding wildcards
+
+ ## Removes a file, after expanding wildcards
+
+ ### Arguments
+ - `string file` - File to remove, may include
+
+ ### Notes:
+ Uses POSIX remove and glob
+
+*/
+void removeWildcard(std::string file){
+    glob_t glob_result;
+    glob(file.c_str(),GLOB_TILDE,NULL,&glob_result);
+    for(unsigned int i=0;i<glob_result.gl_pathc;++i) remove(glob_result.gl_pathv[i]);
+    globfree(&glob_result);
+}
+
+
+/**
+ @brief First file matching a pattern
+
+ ## First file matching a pattern
+
+ ### Notes
+ Returns an empty string if nothing matches
+*/
+std::string globFirst(std::string pattern){
+    glob_t glob_result;
+    string first = (glob(pattern.c_str(),GLOB_TILDE,NULL,&glob_result)==0 && glob_result.gl_pathc>0)?glob_result.gl_pathv[0]:"";
+    globfree(&glob_result);
+    return first;
+}
+
+
+/**
+ @brief Make a path absolute
+
+ ## Make a path absolute, relative to the current working directory
+*/
+string absolutePath(string path){
+    if(!path.empty() && path[0]=='/') return path;
+    char pwd[PATH_MAX];
+    return (getcwd(pwd,sizeof(pwd))!=NULL)?string(pwd)+"/"+path:path;
+}
+
+
+/**
+ @brief Queue files for deletion in the background
+
+ ## Queue files for deletion in the background
+
+ ### Arguments
+ - `string file` - File to remove, may include wildcards
+ - `shared_ptr<int> directory` - Open directory `file` is relative to. If null, `file` is relative to the current directory.
+
+ ### Notes
+ Never blocks: files are deleted by `cleanupWorker` threads.
+*/
+void engine::cleanupPost(std::string file, shared_ptr<int> directory){
+    cleanupPending++;
+    cleanupLock.lock();
+    cleanupQueue.push_back(make_pair(directory,file));
+    cleanupLock.unlock();
+}
+
+
+/**
+ @brief Background cleanup program (threadable)
+
+ ## Deletes files queued with `cleanupPost`
+
+ ### Notes
+ Runs until `exitFlag` is set and the queue is empty. Several of these run at the same time, so deleting thousands of files on a network filesystem does not take one round trip per file.
+*/
+void engine::cleanupWorker(){
+    while(1){
+        pair<shared_ptr<int>,string> item;
+        bool found = 0;
+        cleanupLock.lock();
+        if(!cleanupQueue.empty()){
+            item = cleanupQueue.front();
+            cleanupQueue.pop_front();
+            found = 1;
+        }
+        cleanupLock.unlock();
+
+        if(!found){
+            if(exitFlag) return;
+            usleep(50000);
+            continue;
+        }
+        if(item.first) unlinkat(*item.first,item.second.c_str(),0);
+        else removeWildcard(item.second);
+        cleanupPending--;
+    }
+}
+
+
+/**
+ @brief Wait for all queued deletions to finish
+
+ ## Wait for all queued deletions to finish
+*/
+void engine::cleanupWait(){
+    while(cleanupPending>0) usleep(50000);
+}
+
+
+/**
+ @brief Delete the contents of a directory, in parallel
+
+ ## Delete the contents of a directory, in parallel
+
+ ### Arguments
+ - `string dir` - Directory to empty
+ - `string keep` - File to keep, if it is in the directory (eg. the settings file)
+
+ ### Notes
+ Files are deleted by the cleanup threads, relative to their open parent directory. Subdirectories are removed once they are empty.
+*/
+void engine::wipeDirectory(std::string dir, std::string keep){
+    // Compare resolved paths, since "./settings.yaml" and "/path/to/settings.yaml" may be the same file
+    char resolved[PATH_MAX];
+    if(!keep.empty() && realpath(keep.c_str(),resolved)!=NULL) keep = resolved;
+    string keepName = keep.substr(keep.find_last_of('/')+1);
+    vector<string> directories;
+    vector<string> pending(1,dir);
+    while(!pending.empty()){
+        string current = pending.back(); pending.pop_back();
+        directories.push_back(current);
+        int fd = open(current.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if(fd<0) continue;
+        shared_ptr<int> directory(new int(fd),[](int* f){ close(*f); delete f; });
+        DIR* d = opendir(current.c_str());
+        if(d==NULL) continue;
+        for(struct dirent* entry=readdir(d);entry!=NULL;entry=readdir(d)){
+            string name = entry->d_name;
+            if(name=="." || name=="..") continue;
+            struct stat info;
+            bool isDirectory = (entry->d_type==DT_DIR) || (entry->d_type==DT_UNKNOWN && fstatat(fd,name.c_str(),&info,AT_SYMLINK_NOFOLLOW)==0 && S_ISDIR(info.st_mode));
+            if(isDirectory) pending.push_back(current+"/"+name);
+            else if(keep.empty() || name!=keepName || realpath((current+"/"+name).c_str(),resolved)==NULL || string(resolved)!=keep) cleanupPost(name,directory);
+        }
+        closedir(d);
+    }
+    cleanupWait();
+    for(size_t i=directories.size()-1;i>0;i--) rmdir(directories[i].c_str());
+}
+
+
+/**
+@brief Check if directory is empty
+
+  ## Check run directory for files
+
+  ### Arguments:
+  * `string dir` - Directory to check if running in.
+
+  ### Notes:
+  If it is, it returns zero, otherwise it prompts the user for how they want to procede. Returns 0 if they want to procede and 1 otherwise.
+
+  Cleaning uses `wipeDirectory`, and keeps the settings file.
+*/
+bool engine::directoryEmpty(std::string dir){
+    DIR* d = opendir(dir.c_str());
+    bool empty = 1;
+    if(d!=NULL){
+        for(struct dirent* entry=readdir(d);entry!=NULL && empty;entry=readdir(d)) if(string(entry->d_name)!="." && string(entry->d_name)!="..") empty = 0;
+        closedir(d);
+    }
+    if(empty) return 0;
+    while(1){
+        std::string input = existingFiles;
+        if(input.empty()){
+            std::cout << "Directory not empty. Press c then enter to clean, press s then enter to skip, or press e then enter to exit." << std::endl;
+            if(!(std::cin >> input)) input = "e";
+        }
+        if(input[0]=='c'||input[0]=='C'){
+            std::cout << "Cleaning directory." << std::endl;
+            wipeDirectory(dir,settings);
+            return 0;
+        }
+        if(input[0]=='s'||input[0]=='S'){
+            std::cout << "Skipping clean directory." << std::endl;
+            return 0;
+        }
+        if(input[0]=='e'||input[0]=='E'){
+            std::cout << "Exiting." << std::endl;
+            return 1;
+        }
+        std::cout << "Error. ";
+    }
+}
+
+
+/**
+@brief Storage watchdog program (threadable)
+
+ ## Watches the amount of available storage, and cancels the campaign if <n MB is remaining (configurable).
+
+ ### Arguments:
+ * `double MB` - Remaining storage (in MB) to cancel the campaign at.
+
+ ### Notes:
+ Sleeps 1 second between tests. The campaign is cancelled like `cancel` (running jobs are killed), rather than aborting, since other campaigns may run in the same process.
+**/
+void engine::storageWatchdog(double MB){
+    struct statvfs buf;
+    char pwd[1024];
+    getcwd(pwd, sizeof(pwd));
+
+    while(!exitFlag){
+        statvfs(pwd, &buf);
+        if((buf.f_frsize * buf.f_bavail / 1000000) < MB && !interrupted){
+            quickSlack("STORAGE: Less than "+to_string((int)MB)+" MB left. Cancelling the campaign.",1);
+            interrupted = 1;
+        }
+        sleep(1);
+    }
+}
+
+
+/**
+ @brief Returns a human-readable string of a duration.
+
+    ## Returns a human-readable string of a duration. Credit to TankorSmash on Stackoverflow for the code provided freely in answer to a question asked by sorush-r
+
+    ### Arguments:
+    * `std::chrono::seconds input_seconds` - Duration to convert to human readable string.
+
+    ### Returns:
+    * `std::string` - Human readable time duration.
+*/
+std::string beautify_duration(std::chrono::seconds input_seconds)
+{
+    using namespace std::chrono;
+    typedef duration<int, std::ratio<86400>> days;
+    auto d = duration_cast<days>(input_seconds);
+    input_seconds -= d;
+    auto h = duration_cast<hours>(input_seconds);
+    input_seconds -= h;
+    auto m = duration_cast<minutes>(input_seconds);
+    input_seconds -= m;
+    auto s = duration_cast<seconds>(input_seconds);
+
+    auto dc = d.count();
+    auto hc = h.count();
+    auto mc = m.count();
+    auto sc = s.count();
+
+    std::stringstream ss;
+    ss.fill('0');
+    if (dc) {
+        ss << d.count() << "d";
+    }
+    if (dc || hc) {
+        if (dc) { ss << std::setw(2); } //pad if second set of numbers
+        ss << h.count() << "h";
+    }
+    if (dc || hc || mc) {
+        if (dc || hc) { ss << std::setw(2); }
+        ss << m.count() << "m";
+    }
+    if (dc || hc || mc || sc) {
+        if (dc || hc || mc) { ss << std::setw(2); }
+        ss << s.count() << 's';
+    }
+
+    return ss.str();
+}
+
+
+/**
+ @brief Returns a human-readable string of a size
+
+ ## Returns a human-readable string of a size
+
+ ### Arguments:
+ * `double bytes` - Size to convert to a human readable string
+
+ ### Returns:
+ * `std::string` - Human readable size (eg. "1.5 GB")
+*/
+std::string beautify_bytes(double bytes){
+    const char* units[5] = {"B","kB","MB","GB","TB"};
+    int unit = 0;
+    while(bytes>=1000 && unit<4){ bytes/=1000; unit++; }
+    std::stringstream ss;
+    ss << std::setprecision(3) << bytes << " " << units[unit];
+    return ss.str();
+}
+
+
+/**
+
+ @brief Check if file exists
+
+ ## Check if file exists. Code originally from PherricOxide on stackoverflow, modified slightly
+
+*/
+inline bool fileExists(const std::string& name){
+  struct stat buffer;
+  return (stat (name.c_str(), &buffer) == 0);
+}
+
+
+/**
+ @brief Create a directory and all of its parents
+
+ ## Create a directory and all of its parents (like `mkdir -p`)
+
+ ### Return value
+ Returns 0 on success (including if the directory already exists), 1 otherwise
+*/
+bool makeDirectory(string dir){
+    for(size_t i=1;i<=dir.size();i++){
+        if(i<dir.size() && dir[i]!='/') continue;
+        if(mkdir(dir.substr(0,i).c_str(),0755) && errno!=EEXIST) return 1;
+    }
+    return 0;
+}
+
+
+/**
+ @brief Move the contents of a directory into another, and remove it
+
+ ## Move the contents of a directory into another, and remove it
+
+ ### Arguments
+ - `string from` - Directory to empty and remove
+ - `string to` - Directory to move the files into
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Files are renamed if possible, and otherwise copied (eg. from node-local scratch to a network filesystem).
+*/
+bool moveDirectory(string from, string to){
+    DIR* dir = opendir(from.c_str());
+    if(dir==NULL) return 1;
+    bool failed = 0;
+    for(struct dirent* entry=readdir(dir);entry!=NULL;entry=readdir(dir)){
+        string name = entry->d_name;
+        if(name=="." || name=="..") continue;
+        string source = from+"/"+name, destination = to+"/"+name;
+        if(rename(source.c_str(),destination.c_str())==0) continue;
+        if(errno!=EXDEV){ failed = 1; continue; }
+        ifstream in(source,ios::binary);
+        ofstream out(destination,ios::binary);
+        out << in.rdbuf();
+        out.close();
+        if(!out.good()){ failed = 1; continue; }
+        remove(source.c_str());
+    }
+    closedir(dir);
+    if(rmdir(from.c_str())) failed = 1;
+    return failed;
+}
+
+
+/**
+ @brief Directory a run keeps its results in
+
+ ## Directory a run keeps its results in
+
+ ### Notes
+ If `runDirectories` is set, runs are sharded by run number into `runs/<run/100>/<run%100>/` (eg. run 1234 is in `runs/012/34/`), so no directory ever holds more than a few hundred files. Otherwise everything is in the current directory.
+*/
+string engine::runDirectory(int runNumber){
+    if(!runDirectories) return ".";
+    char dir[64];
+    snprintf(dir,sizeof(dir),"runs/%03d/%02d",runNumber/100,runNumber%100);
+    return dir;
+}
+
+
+/**
+ @brief Directory (under `scratch`) this campaign runs simulations in
+
+ ## Directory (under `scratch`) this campaign runs simulations in
+
+ ### Notes
+ Created by `mkdtemp` when the campaign starts (see `execute`), since several campaigns may share the process, and the scratch directory.
+*/
+string engine::scratchDirectory(){
+    return scratchRun;
+}
+
+
+/**
+ @brief Post message as slack bot, rather than with webhook
+
+ ## Sends slack message
+
+ ### Arguments:
+ * `string token` - Bot oath2 token to use
+ * `string channel` - Channel to post to (Bot must have access to this channel)
+ * `string message` - Message to post
+
+ ### Notes:
+ Will return the timestamp of the message in case you want to update it later
+
+ To use, you will need to go to api.slack.com, and get an bot token for whichever DM or channel you want to message.
+*/
+std::string slackBotPost(std::string token,std::string channel,std::string message){
+    system(("curl -X POST -H 'Authorization: Bearer "+token+"' -H 'Content-type: application/json' --data '{\"channel\":\""+channel+"\",\"text\":\""+message+"\"}' https://slack.com/api/chat.postMessage -s | grep -e \"\\\"ts\\\":\\\"[0-9.]*\\\"\" -o | grep \"[0-9.]*\" -o > slack.bot.timestamp.log.tmp").c_str());
+    std::ifstream ts("slack.bot.timestamp.log.tmp");
+    std::string timestamp; ts >> timestamp;
+    system("rm slack.bot.timestamp.log.tmp");
+    return timestamp;
+}
+
+
+/**
+ @brief Update message posted as slack bot
+
+ ## Updates slack message
+
+ ### Arguments:
+ * `string token` - Bot oath2 token to use
+ * `string channel` - Channel to post to (Bot must have access to this channel)
+ * `string ts` - Timestamp of post to update
+ * `string message` - New message
+
+ ### Notes:
+ To use, you will need to go to api.slack.com, and get an bot token for whichever DM or channel you want to message.
+*/
+void slackBotUpdate(std::string token,std::string channel,std::string ts,std::string message){
+    system(("curl -X POST -H 'Authorization: Bearer "+token+"' -H 'Content-type: application/json' --data '{\"channel\":\""+channel+"\",\"ts\":\""+ts+"\",\"text\":\""+message+"\"}' https://slack.com/api/chat.update -s -o /dev/null").c_str());
+}
+
+
+/**
+@brief Emails user
+
+ ## Email user
+
+ ### Arguments:
+ * `string destination` - Email to send to
+ * `string message` - Message of Email
+
+ ### Notes:
+ To email when program is complete, in your main, add the following line: `std::atexit(email(destination,message));`
+
+ Also, please use this sparingly. If any major email providers decide that it is spam, then its going to be broken for everyone on cronos forever.
+*/
+void email(std::string destination, std::string message){
+    system(("echo "+message+" | sendmail -F JARVIS "+destination).c_str());
+    return;
+}
+
+
+/**
+ @brief Completion of a run in flight
+
+ ## Completion of a run in flight
+
+ ### Arguments
+ - `runState& state` - Run in flight
+
+ ### Return value
+ Returns the completed fraction of the current attempt of the run, below 1 until it is done
+
+ ### Notes
+ Cosima and revan are weighed by their share in the duration of the runs so far (`cosimaShare`). Cosima is done once it simulated the triggers (or events) of the run. If their number is not known, its completion is estimated from the time spent against the average run. Revan is done once it analysed every event cosima simulated.
+*/
+double engine::runCompletion(runState& state){
+    if(state.winner>=0) return 1;
+    double simulated = state.simulated, analysed = state.analysed, cosima = 0;
+    if(state.simulatedAll) cosima = 1;
+    else if(state.target>0) cosima = min(1.0,simulated/state.target);
+    else {
+        timeLock.lock();
+        double average = averageTime.count();
+        timeLock.unlock();
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now()-state.started).count();
+        if(average>0) cosima = min(1.0,elapsed/(average*cosimaShare));
+    }
+    double events = state.simulatedAll?simulated:state.target;
+    double revan = (events>0)?min(1.0,analysed/events):0;
+    return min(0.99,cosimaShare*cosima+(1-cosimaShare)*revan);
+}
+
+
+/**
+ @brief Progress of the campaign
+
+ ## Progress of the campaign
+
+ ### Arguments
+ - `double& runs` - Set to the number of runs done, counting the completed part of every run in flight
+ - `long long& events` - Set to the number of events simulated so far, in every attempt
+ - `vector<pair<int,double>>* completion` - If given, set to the completion of every run in flight (see `runCompletion`), by run number
+*/
+void engine::campaignProgress(double& runs, long long& events, vector<pair<int,double>>* completion){
+    lock_guard<mutex> lock(inflightLock);
+    runs = statusBar[7];
+    events = eventsFinished;
+    for(auto& run:runsInFlight){
+        double done = runCompletion(*run.second);
+        runs += done;
+        events += run.second->simulated;
+        if(completion!=NULL) completion->push_back(make_pair(run.first,done));
+    }
+}
+
+
+/**
+ @brief Time left before every run is done
+
+ ## Time left before every run is done
+
+ ### Arguments
+ - `double runs` - Number of runs done (see `campaignProgress`)
+
+ ### Return value
+ Returns the time left in seconds, at the rate runs were done since the first one started, or -1 if it is not known yet
+*/
+double engine::campaignEta(double runs){
+    double started = runsStarted;
+    if(started==0 || runs<=0) return -1;
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count()-started;
+    return max(0.0,(statusBar[8]-runs)*elapsed/runs);
+}
+
+
+/**
+ @brief Number of events simulated per second
+
+ ## Number of events simulated per second
+
+ ### Arguments
+ - `long long events` - Number of events simulated so far (see `campaignProgress`)
+
+ ### Return value
+ Returns the rate over the last minute (or since the first sample)
+*/
+double engine::eventRate(long long events){
+    double now = chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+    lock_guard<mutex> lock(eventLock);
+    eventSamples.push_back(make_pair(now,events));
+    while(eventSamples.size()>2 && now-eventSamples[1].first>=60) eventSamples.pop_front();
+    double span = now-eventSamples.front().first;
+    return (span>0)?max(0.0,(events-eventSamples.front().second)/span):0;
+}
+
+
+/**
+ @brief Print simulation status bar
+
+ ## Print simulation status bar
+
+ ### Notes
+ Constructs status and adds a spinner to indicate that the simulation is still alive. Prints the same message to slack. Once runs started, it includes their average completion, the events simulated per second, and the time left (see `campaignProgress`), updated as cosima and revan print their counters rather than only when runs finish.
+*/
+void engine::handleStatus(){
+    char spinner[4] = {'-','\\','|','/'};
+    unsigned int i=0;
+    string ts = "";
+    if(!token.empty() && !channel.empty()) ts=slackBotPost(token,channel,"> J.A.R.V.I.S., are you up?\nFor you sir, always.");
+    while(!exitFlag){
+        stringstream currentStatus;
+        if(statusBar[0]) currentStatus << std::setprecision(3) << "Geomega: " << ((double) statusBar[1]*100)/statusBar[2] << "% ["+to_string(statusBar[1])+"/"+to_string(statusBar[2])+"] | ";
+        if(statusBar[3]) currentStatus << std::setprecision(3) << "Cosima: " << ((double) statusBar[4]*100)/statusBar[5] << "% ["+to_string(statusBar[4])+"/"+to_string(statusBar[5])+"] | ";
+        if(statusBar[6]) currentStatus << std::setprecision(3) << "Revan: " << ((double) statusBar[7]*100)/statusBar[8] << "% ["+to_string(statusBar[7])+"/"+to_string(statusBar[8])+"] | ";
+        if(!stages.empty()){
+            stageLock.lock();
+            for(auto& stage:stages) currentStatus << stage.name+": "+to_string(stage.done)+((stage.failed!=0)?" ("+to_string(stage.failed)+" failed)":"")+" | ";
+            stageLock.unlock();
+        }
+        if(averageTime.count()!=0) currentStatus << "Running average time: " + beautify_duration(averageTime) + " | ";
+        if(statusBar[6]){
+            double runs;
+            long long events;
+            vector<pair<int,double>> completion;
+            campaignProgress(runs,events,&completion);
+            double rate = eventRate(events), eta = campaignEta(runs), done = 0;
+            for(auto& run:completion) done += run.second;
+            if(!completion.empty()) currentStatus << std::setprecision(3) << "Running: " << completion.size() << " at " << done*100/completion.size() << "% | ";
+            if(rate>0) currentStatus << "Events: " << (long long)rate << "/s | ";
+            if(eta>=1) currentStatus << "ETA: " + beautify_duration(chrono::seconds((long)eta)) + " | ";
+        }
+        if(placement){
+            // Busy core sets per NUMA node
+            map<int,pair<int,int>> nodes;
+            placementLock.lock();
+            for(auto& slot:placementSlots){ nodes[slot.node].first+=(slot.jobs>0); nodes[slot.node].second++; }
+            placementLock.unlock();
+            for(auto& node:nodes) currentStatus << "Node "+to_string(node.first)+": "+to_string(node.second.first)+"/"+to_string(node.second.second)+" | ";
+        }
+        char spin = spinner[i++%4];
+        if(!quiet) cout << "\r" << currentStatus.str() << spin << "        " << flush;
+        if(i%5==0 && !token.empty() && !channel.empty()) slackBotUpdate(token,channel,ts,currentStatus.str()+spinner[i++%4]);
+        usleep(400000);
+    }
+}
+
+
+/**
+ @brief Quick alias for slack notifications
+
+ ## Alias for slack notifications
+
+ ### Notes:
+ Only prints slack message if it has a valid token and channel. The message is also printed to stderr, or given to the `onMessage` callback if there is one
+*/
+void engine::quickSlack(string message,int verbosity){
+    if(!token.empty() && !channel.empty() && verbosity<=slackVerbosity) slackBotPost(token,channel,message);
+    if(messageCallback) messageCallback(message);
+    else cerr << message << endl;
+}
+
+
+/**
+ @brief Build the core sets jobs are pinned to from the CPU topology
+
+ ## Build the core sets jobs are pinned to from the CPU topology
+
+ ### Arguments
+ - `int coresPerJob` - Number of physical cores in each core set
+ - `int helperCores` - Number of physical cores reserved for helper processes
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Reads the topology from `/sys/devices/system/cpu`, and only uses the CPUs autoMEGA is allowed to run on. Logical CPUs are grouped into physical cores, and the cores into core sets of `coresPerJob` cores of the same NUMA node (the last core set of a node may be smaller). The last `helperCores` cores are reserved for helper processes, and kept out of the core sets.
+*/
+int engine::placementSetup(int coresPerJob, int helperCores){
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0,sizeof(allowed),&allowed)){
+        quickSlack("PLACEMENT SETUP: Could not get CPU affinity.",1);
+        return 1;
+    }
+    auto readInt = [](string file, int fallback){ int value=fallback; ifstream in(file); if(in) in>>value; return value; };
+
+    // Group logical CPUs into physical cores, as (node, package, core) -> CPUs
+    map<tuple<int,int,int>,vector<int>> cores;
+    glob_t cpus;
+    if(glob("/sys/devices/system/cpu/cpu[0-9]*",0,NULL,&cpus)){
+        globfree(&cpus);
+        quickSlack("PLACEMENT SETUP: Could not read the CPU topology from /sys/devices/system/cpu.",1);
+        return 1;
+    }
+    for(size_t i=0;i<cpus.gl_pathc;i++){
+        string cpuDir = cpus.gl_pathv[i];
+        int cpu = atoi(cpuDir.substr(cpuDir.rfind("cpu")+3).c_str());
+        // cpu0 usually has no "online" file, since it cannot be taken offline
+        if(cpu>=CPU_SETSIZE || !CPU_ISSET(cpu,&allowed) || !readInt(cpuDir+"/online",1)) continue;
+        string nodeDir = globFirst(cpuDir+"/node[0-9]*");
+        int node = nodeDir.empty()?0:atoi(nodeDir.substr(nodeDir.rfind("node")+4).c_str());
+        cores[make_tuple(node,readInt(cpuDir+"/topology/physical_package_id",0),readInt(cpuDir+"/topology/core_id",cpu))].push_back(cpu);
+    }
+    globfree(&cpus);
+    if(coresPerJob<1 || helperCores<0 || (int)cores.size()<=helperCores){
+        quickSlack("PLACEMENT SETUP: Cannot reserve "+to_string(helperCores)+" helper cores and build core sets of "+to_string(coresPerJob)+" cores from "+to_string(cores.size())+" cores.",1);
+        return 1;
+    }
+
+    // Reserve the last cores for helpers, and split the rest into core sets
+    int remaining = cores.size()-helperCores, slotCores = 0;
+    lock_guard<mutex> lock(placementLock);
+    placementSlots.clear();
+    helperCPUs = "";
+    for(auto& core:cores){
+        sort(core.second.begin(),core.second.end());
+        if(remaining--<=0){
+            for(auto& cpu:core.second) helperCPUs+=(helperCPUs.empty()?"":",")+to_string(cpu);
+            continue;
+        }
+        int node = get<0>(core.first);
+        if(placementSlots.empty() || placementSlots.back().node!=node || slotCores>=coresPerJob){
+            placementSlots.push_back(placementSlot());
+            placementSlots.back().node = node;
+            slotCores = 0;
+        }
+        slotCores++;
+        placementSlots.back().cpus.insert(placementSlots.back().cpus.end(),core.second.begin(),core.second.end());
+    }
+    return 0;
+}
+
+
+/**
+ @brief Pin the calling thread (and so every process it starts) to the least busy core set
+
+ ## Pin the calling thread to the least busy core set
+
+ ### Return value
+ Returns the core set used, to be given back to `placementRelease`, or -1 if placement is disabled
+
+ ### Notes
+ Both the CPU affinity and the memory policy are inherited by every thread and process started from the calling thread afterwards. If there are more jobs than core sets, the least busy core set is shared.
+*/
+int engine::placementAcquire(){
+    if(!placement) return -1;
+    lock_guard<mutex> lock(placementLock);
+    int slot = 0;
+    for(size_t i=1;i<placementSlots.size();i++) if(placementSlots[i].jobs<placementSlots[slot].jobs) slot = i;
+    placementSlot& chosen = placementSlots[slot];
+    chosen.jobs++;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(auto& cpu:chosen.cpus) CPU_SET(cpu,&set);
+    if(sched_setaffinity(0,sizeof(set),&set)) quickSlack("PLACEMENT: Could not pin job to core set "+to_string(slot)+".",1);
+
+    if(bindMemory){
+        const size_t bits = 8*sizeof(unsigned long);
+        vector<unsigned long> nodes(chosen.node/bits+1,0);
+        nodes[chosen.node/bits] |= 1UL<<(chosen.node%bits);
+        if(syscall(SYS_set_mempolicy,MPOL_BIND,nodes.data(),nodes.size()*bits+1)) quickSlack("PLACEMENT: Could not bind job memory to NUMA node "+to_string(chosen.node)+".",1);
+    }
+    return slot;
+}
+
+
+/**
+ @brief Give back a core set taken by `placementAcquire`
+
+ ## Give back a core set taken by `placementAcquire`
+
+ ### Arguments
+ - `int slot` - Core set returned by `placementAcquire`
+*/
+void engine::placementRelease(int slot){
+    if(slot<0) return;
+    lock_guard<mutex> lock(placementLock);
+    placementSlots[slot].jobs--;
+}
+
+
+/**
+ @brief Count printed on a line of output
+
+ ## Count printed on a line of output
+
+ ### Arguments
+ - `string line` - Line of output
+
+ ### Return value
+ Returns the count of a counter line, or -1
+
+ ### Notes
+ Counter lines start with "trigger" or "event" (in any case, also "triggers", "triggered", "events", and "event id", "event number" or "triggered events"), followed by the count, eg. `Event 1200`, `Triggers: 1200` or `Event ID 1200/5000`. Numbers anywhere else are ignored, so other output of cosima and revan (including the `.Triggers` and `.Events` keywords of an echoed source file) does not move the counter.
+*/
+long long progressCount(string line){
+    static const regex counter("^[ \t]*(triggers?|triggered|events?)([ \t]+(events?|id|number|no\\.?))?[ \t]*[:=#]?[ \t]*([0-9]+)([ \t/,;]|$)");
+    transform(line.begin(),line.end(),line.begin(),::tolower);
+    smatch match;
+    if(regex_search(line,match,counter)) return atoll(match[4].str().c_str());
+    return -1;
+}
+
+
+/**
+ @brief Read the output of a program, and raise a counter to the last count it printed
+
+ ## Read the output of a program, and raise a counter to the last count it printed
+
+ ### Arguments
+ - `int fd` - Non blocking file descriptor to read from
+ - `string& partial` - Unfinished last line, kept between calls
+ - `atomic<long long>& progress` - Counter to raise (see `progressCount`)
+ - `int wait` - Milliseconds to wait for output
+ - `long long limit` - Highest possible count (0 if it is not known): larger counts are ignored
+
+ ### Return value
+ Returns false once the output is closed, so the caller has to wait by other means
+
+ ### Notes
+ Lines end with a newline or a carriage return (for progress lines rewritten in place). The counter is never lowered, so copies of a run can share it.
+*/
+bool readProgress(int fd, string& partial, atomic<long long>& progress, int wait, long long limit=0){
+    struct pollfd output = {fd,POLLIN,0};
+    if(wait>0 && poll(&output,1,wait)<=0) return 1;
+    char buffer[65536];
+    ssize_t length;
+    while((length = read(fd,buffer,sizeof(buffer)))>0){
+        for(ssize_t i=0;i<length;i++){
+            if(buffer[i]!='\n' && buffer[i]!='\r'){
+                if(partial.size()<4096) partial += buffer[i];
+                continue;
+            }
+            long long count = progressCount(partial);
+            if(limit>0 && count>limit) count = -1;
+            long long current = progress;
+            while(count>current && !progress.compare_exchange_weak(current,count));
+            partial.clear();
+        }
+    }
+    return length<0;
+}
+
+
+/**
+ @brief Run a shell command in its own process group, with a timeout
+
+ ## Run a shell command in its own process group, with a timeout
+
+ ### Arguments
+ - `string command` - Command to run (with `sh -c`)
+ - `double timeout` - Seconds after which the command is killed, not counting time spent paused (0 for no timeout)
+ - `atomic<bool>* cancel` - If given, the command is killed as soon as it is set
+ - `double* duration` - If given, set to the time (in seconds, not counting time spent paused) the command ran for
+ - `atomic<long long>* progress` - If given, the command gets a pipe as file descriptor 3, and the counter is raised to the last count written to it (see `readProgress`)
+ - `double* setup` - If given (with `progress`), set to the time (in seconds, not counting time spent paused) the command ran for before the counter was first raised, or -1 if it never was
+ - `long long limit` - Highest possible count for `progress` (0 if it is not known)
+
+ ### Return value
+ Returns the exit status of the command, `commandTimedOut` if it timed out, `commandCancelled` if it was killed through `cancel` or `interrupted`, or -1 if it could not be started
+
+ ### Notes
+ Used instead of `system()`. The command runs in its own process group, so the whole pipeline (bash, the MEGAlib program, and xz) is stopped (while `paused` is set), continued, and killed together.
+*/
+const int commandTimedOut = -2, commandCancelled = -3;
+int engine::runCommand(string command, double timeout, atomic<bool>* cancel, double* duration, atomic<long long>* progress, double* setup, long long limit){
+    int tap[2] = {-1,-1};
+    if(progress!=NULL && pipe2(tap,O_CLOEXEC)==0) fcntl(tap[0],F_SETFL,O_NONBLOCK);
+    pid_t pid = fork();
+    if(pid<0){
+        for(int fd:tap) if(fd>=0) close(fd);
+        return -1;
+    }
+    if(pid==0){
+        setpgid(0,0);
+        if(tap[1]==3) fcntl(3,F_SETFD,0);
+        else if(tap[1]>=0) dup2(tap[1],3);
+        execl("/bin/sh","sh","-c",command.c_str(),(char*)NULL);
+        _exit(127);
+    }
+    setpgid(pid,pid);
+    if(tap[1]>=0) close(tap[1]);
+    string partial;
+    if(setup!=NULL) *setup = -1;
+
+    int status = 0, result = -1;
+    bool stopped = 0;
+    double elapsed = 0;
+    auto last = chrono::steady_clock::now();
+    while(1){
+        pid_t done = waitpid(pid,&status,WNOHANG);
+        if(done==pid){
+            result = WIFEXITED(status)?WEXITSTATUS(status):128+WTERMSIG(status);
+            break;
+        }
+        if(done<0) break;
+
+        auto now = chrono::steady_clock::now();
+        if(!stopped) elapsed += chrono::duration<double>(now-last).count();
+        last = now;
+        bool killed = interrupted || (cancel!=NULL && *cancel);
+        if(killed || (timeout>0 && elapsed>timeout)){
+            kill(-pid,SIGKILL);
+            kill(-pid,SIGCONT);
+            waitpid(pid,&status,0);
+            result = killed?commandCancelled:commandTimedOut;
+            break;
+        }
+        if(paused!=stopped){
+            stopped = paused;
+            kill(-pid,stopped?SIGSTOP:SIGCONT);
+        }
+        if(tap[0]<0 || !readProgress(tap[0],partial,*progress,100,limit)) usleep(100000);
+        if(setup!=NULL && *setup<0 && progress!=NULL && *progress>0) *setup = elapsed;
+    }
+    if(tap[0]>=0){
+        readProgress(tap[0],partial,*progress,0,limit);
+        close(tap[0]);
+    }
+    if(duration!=NULL) *duration = elapsed;
+    return result;
+}
+
+
+/**
+ @brief Parse iterative nodes in list or pattern mode
+
+ ## Parse iterative nodes
+
+ ### Arguments
+ * `YAML::NODE contents` - Node to parse
+
+ ### Notes
+ There are two distinct parsing modes. If there are exactly three elements in the list, then it assumes it is in the format [first value, last value, step size]. If there is exactly one element, it is assumed it is a list of all values to use.
+
+ Values are assumed as doubles if they are in three element format, otherwise they are assumed as strings.
+
+ If `elements` is given, it is filled with the value of each element of every option (eg. for the catalog). If `numeric` is given, it records which elements were in three element format.
+*/
+vector<string> engine::parseIterativeNode(YAML::Node contents, std::string prepend, vector<vector<string>>* elements, vector<bool>* numeric){
+    vector<string> options; options.push_back(prepend);
+    vector<string> newOptions;
+    vector<vector<string>> optionElements(1), newElements;
+    if(numeric!=NULL) numeric->clear();
+    if(contents.size()==0) quickSlack("Warning: PARSEITERATIVENODE: Empty iterative node set.",1);
+    for(size_t i=0;i<contents.size();i++){
+        // Parse options into vector of strings
+        vector<string> parameters;
+        if(contents[i].size()==3 && contents[i][0].size()==0 && contents[i][1].size()==0 && contents[i][2].size()==0){
+            double initial = contents[i][0].as<double>();
+            double final = contents[i][1].as<double>();
+            double step = contents[i][2].as<double>();
+            if(numeric!=NULL) numeric->push_back(1);
+            if((final-initial)*step < 0) quickSlack("Warning: PARSEITERATIVENODE: Step size of opposite sign to difference between final and initial values.",1);
+            for(int total=0;initial<final;initial+=step){
+                parameters.push_back(to_string(initial));
+                if(total++>100000){
+                    quickSlack("PARSEITERATIVENODE: More than 100000 options generated. This will likely cause RAM issues. This is likely due to a step size that is too small or of the wrong sign. Exiting.");
+                    exitFlag=1;
+                    vector<string> empty; return empty;
+                }
+            }
+        } else if(contents[i].size()==1){
+            if(numeric!=NULL) numeric->push_back(0);
+            if(contents[i][0].size()==0){
+                parameters.push_back("");
+                quickSlack("Warning: PARSEITERATIVENODE: Empty iterative node.",1);
+            }
+            for(size_t j=0;j<contents[i][0].size();j++){
+                if(std::find(parameters.begin(),parameters.end(),contents[i][0][j].as<string>())!=parameters.end()) quickSlack("Warning: PARSEITERATIVENODE: Duplicate value in literal iterator.",1);
+                parameters.push_back(contents[i][0][j].as<string>());
+            }
+        } else{
+            quickSlack("PARSEITERATIVENODE: Malformed iterative node. Please see manual on correct format for iterative nodes. Exiting.");
+            exitFlag=1;
+            vector<string> empty; return empty;
+        }
+        for(size_t j=0;j<options.size();j++){
+            for(size_t k=0;k<parameters.size();k++){
+                newOptions.push_back(options[j]+" "+parameters[k]);
+                if(elements==NULL) continue;
+                newElements.push_back(optionElements[j]);
+                newElements.back().push_back(parameters[k]);
+            }
+        }
+        options.clear();
+        options = std::move(newOptions);
+        optionElements = std::move(newElements);
+        newElements.clear();
+    }
+    if(elements!=NULL) elements->swap(optionElements);
+    return options;
+}
+
+
+/**
+ @brief Quote a string for use in an SQL statement
+
+ ## Quote a string for use in an SQL statement
+*/
+string sqlQuote(string value){
+    string quoted = "'";
+    for(auto& c:value){
+        if(c=='\'') quoted+='\'';
+        quoted+=c;
+    }
+    return quoted+"'";
+}
+
+
+/**
+ @brief Queue an SQL statement for the catalog
+
+ ## Queue an SQL statement for the catalog
+
+ ### Notes
+ Never blocks on the database: statements are executed in order by `catalogWriter`.
+*/
+void engine::catalogPost(string statement){
+    if(catalog==NULL) return;
+    catalogLock.lock();
+    catalogQueue.push_back(statement);
+    catalogLock.unlock();
+}
+
+
+/**
+ @brief Catalog writer (threadable)
+
+ ## Writes queued statements to the catalog
+
+ ### Notes
+ Everything queued since the last pass is written in a single transaction. Exits once `catalogDone` is set and the queue is empty.
+*/
+void engine::catalogWriter(){
+    while(1){
+        deque<string> pending;
+        catalogLock.lock();
+        pending.swap(catalogQueue);
+        catalogLock.unlock();
+
+        if(pending.empty()){
+            if(catalogDone) return;
+            usleep(200000);
+            continue;
+        }
+        sqlite3_exec(catalog,"BEGIN",NULL,NULL,NULL);
+        for(auto& statement:pending){
+            char* error = NULL;
+            if(sqlite3_exec(catalog,statement.c_str(),NULL,NULL,&error)!=SQLITE_OK){
+                quickSlack("CATALOG: "+string((error!=NULL)?error:"Unknown error")+" in \""+statement+"\".",1);
+                sqlite3_free(error);
+            }
+        }
+        sqlite3_exec(catalog,"COMMIT",NULL,NULL,NULL);
+    }
+}
+
+
+/**
+ @brief Name the catalog columns of a set of parameters
+
+ ## Name the catalog columns of a set of parameters
+
+ ### Arguments
+ - `vector<parameter>& parameters` - Parameters to name the columns of
+ - `string prefix` - Prefix of the column names (`geo` or `src`)
+
+ ### Notes
+ Each parameter gets a text column holding its full value, named `<prefix>_<name>`, and a typed column `<prefix>_<name>_<element>` for each element taking more than one value.
+*/
+void catalogColumns(vector<parameter>& parameters, string prefix){
+    for(auto& p:parameters){
+        p.column = prefix+"_";
+        for(auto& c:p.name) p.column += isalnum(c)?c:'_';
+        if(p.elements.empty()) continue; // Rebuilt from a previous catalog (see reprocessSetup), so varying is already known
+        p.varying.assign(p.numeric.size(),0);
+        for(size_t i=0;i<p.varying.size();i++) for(auto& e:p.elements) if(e.size()>i && e[i]!=p.elements[0][i]) p.varying[i]=1;
+    }
+}
+
+
+/**
+ @brief Values of one combination of parameters, by catalog column
+
+ ## Values of one combination of parameters, by catalog column
+
+ ### Arguments
+ - `vector<parameter>& parameters` - Parameters to describe
+ - `int index` - Index of the combination
+ - `bool firstFastest` - Whether the first parameter varies fastest (cosima) or slowest (geomega)
+ - `vector<pair<string,string>>& values` - List of (column, value) to append to
+*/
+void parameterValues(vector<parameter>& parameters, int index, bool firstFastest, vector<pair<string,string>>& values){
+    for(size_t n=0;n<parameters.size();n++){
+        parameter& p = parameters[firstFastest?n:parameters.size()-1-n];
+        if(p.options.empty()) continue;
+        size_t option = index%p.options.size();
+        index /= p.options.size();
+        values.push_back(make_pair(p.column,p.options[option]));
+        for(size_t i=0;i<p.varying.size();i++){
+            if(!p.varying[i] || i>=p.elements[option].size()) continue;
+            values.push_back(make_pair(p.column+"_"+to_string(i),p.elements[option][i]));
+        }
+    }
+}
+
+
+/**
+ @brief Columns and values describing one combination of parameters
+
+ ## Columns and values describing one combination of parameters
+
+ ### Arguments
+ - `vector<parameter>& parameters` - Parameters to describe
+ - `int index` - Index of the combination
+ - `bool firstFastest` - Whether the first parameter varies fastest (cosima) or slowest (geomega)
+ - `string& columns` - Comma separated list of columns to append to
+ - `string& values` - Comma separated list of values to append to
+*/
+void catalogValues(vector<parameter>& parameters, int index, bool firstFastest, string& columns, string& values){
+    vector<pair<string,string>> described;
+    parameterValues(parameters,index,firstFastest,described);
+    for(auto& value:described){
+        columns += ","+value.first;
+        values += ","+sqlQuote(value.second);
+    }
+}
+
+
+/**
+ @brief Create the results catalog
+
+ ## Create the results catalog
+
+ ### Arguments
+ - `string filename` - Catalog to create (replaced, with its journal files, if it exists)
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ The catalog is an sqlite database with one record per run (`runs`) and per geometry variant (`geometries`). Each parameter is stored in its own column, so runs can be selected by parameter values (eg. `SELECT tra FROM runs WHERE src_Pos_Beam_1=90`). Every parameter column is indexed. `parameters` describes the parameter columns, `stages` records every job of the stages after revan, `summaries` holds the counters and spectrum of every summarised run (see `summariseRun`), and `campaign` holds general information on the campaign.
+
+ Elements given as numeric ranges are stored as `REAL`, other elements as `NUMERIC` (so numeric literals are still stored as numbers).
+*/
+bool engine::catalogOpen(string filename){
+    // Also remove the journals a crashed campaign may have left, so they are not replayed into the new catalog
+    for(string suffix:{"","-wal","-shm","-journal"}) remove((filename+suffix).c_str());
+    if(sqlite3_open(filename.c_str(),&catalog)!=SQLITE_OK){
+        quickSlack("CATALOG: Could not create catalog \""+filename+"\".",1);
+        sqlite3_close(catalog);
+        catalog = NULL;
+        return 1;
+    }
+    catalogColumns(geometryParameters,"geo");
+    catalogColumns(sourceParameters,"src");
+
+    string columns, indexes;
+    string describe = "INSERT INTO parameters VALUES ";
+    bool first = 1;
+    for(auto* set:{&geometryParameters,&sourceParameters}){
+        for(auto& p:*set){
+            columns += ","+p.column+" TEXT";
+            indexes += "CREATE INDEX "+p.column+"_index ON runs("+p.column+");";
+            describe += string(first?"":",")+"("+sqlQuote(p.column)+","+sqlQuote(p.name)+",NULL,"+sqlQuote(p.file)+","+((set==&geometryParameters)?to_string(p.line):"NULL")+")";
+            first = 0;
+            for(size_t i=0;i<p.varying.size();i++){
+                if(!p.varying[i]) continue;
+                string column = p.column+"_"+to_string(i);
+                columns += ","+column+(p.numeric[i]?" REAL":" NUMERIC");
+                indexes += "CREATE INDEX "+column+"_index ON runs("+column+");";
+                describe += ",("+sqlQuote(column)+","+sqlQuote(p.name)+","+to_string(i)+","+sqlQuote(p.file)+","+((set==&geometryParameters)?to_string(p.line):"NULL")+")";
+            }
+        }
+    }
+    string geometryColumns;
+    for(auto& p:geometryParameters){
+        geometryColumns += ","+p.column+" TEXT";
+        for(size_t i=0;i<p.varying.size();i++) if(p.varying[i]) geometryColumns += ","+p.column+"_"+to_string(i)+(p.numeric[i]?" REAL":" NUMERIC");
+    }
+
+    string schema = "PRAGMA journal_mode=WAL;"
+        "PRAGMA synchronous=NORMAL;"
+        "CREATE TABLE campaign(key TEXT PRIMARY KEY, value TEXT);"
+        "CREATE TABLE parameters(name TEXT PRIMARY KEY, parameter TEXT, element INTEGER, file TEXT, line INTEGER);"
+        "CREATE TABLE geometries(geometry_id INTEGER PRIMARY KEY, file TEXT, status TEXT, checked TEXT"+geometryColumns+");"
+        "CREATE TABLE runs(run_id INTEGER PRIMARY KEY, geometry_id INTEGER, source TEXT, directory TEXT, seed INTEGER, attempts INTEGER, status TEXT, started INTEGER, finished INTEGER, sim TEXT, tra TEXT, cosima_log TEXT, revan_log TEXT, sim_bytes INTEGER, tra_bytes INTEGER, timing_value REAL, timing_fraction REAL, setup REAL"+columns+");"
+        "CREATE TABLE stages(run_id INTEGER, stage TEXT, status TEXT, started INTEGER, finished INTEGER, log TEXT, outputs TEXT);"
+        "CREATE TABLE summaries(run_id INTEGER PRIMARY KEY, events INTEGER, types TEXT, flags TEXT, spectrum TEXT);"
+        "CREATE INDEX stages_run_index ON stages(run_id);"
+        "CREATE INDEX geometry_id_index ON runs(geometry_id);"
+        "CREATE INDEX status_index ON runs(status);"
+        "CREATE INDEX finished_index ON runs(finished);"
+        +indexes
+        +"INSERT INTO campaign VALUES ('settings',"+sqlQuote(settings)+"),('started',"+to_string(time(NULL))+"),('seed',"+sqlQuote(to_string(masterSeed))+"),('timing',"+sqlQuote(sourceTiming[0]+" "+sourceTiming[1])+");";
+    if(!first) schema += describe+";";
+
+    char* error = NULL;
+    if(sqlite3_exec(catalog,schema.c_str(),NULL,NULL,&error)!=SQLITE_OK){
+        quickSlack("CATALOG: Could not create catalog tables: "+string((error!=NULL)?error:"Unknown error"),1);
+        sqlite3_free(error);
+        sqlite3_close(catalog);
+        catalog = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+
+/**
+ @brief Geometry file held in memory, along with its include structure
+
+ ## Geometry file held in memory
+
+ ### Notes
+ `text` always ends with a newline, so every line (newline included) is the span from its offset in `lines` to the next one. `includes` maps the (zero indexed) line number of each `Include` line to the index of the included file in the owning `geoTree`.
+*/
+struct geoFile {
+    /// Resolved path of the file
+    string path;
+    /// Path the file was first opened with, which its includes are relative to
+    string opened;
+    /// Reference used to include the file (as written after `Include`)
+    string reference;
+    /// Contents of the file
+    string text;
+    /// Offset of the start of every line in `text`
+    vector<size_t> lines;
+    /// Include lines, as (line index, file index) pairs
+    vector<pair<size_t,size_t>> includes;
+};
+
+
+/**
+ @brief Include tree of a geometry, each distinct file loaded once
+
+ ## Include tree of a geometry
+
+ ### Notes
+ `files[0]` is always the top level setup file.
+*/
+struct geoTree {
+    /// All distinct files in the geometry
+    vector<geoFile> files;
+    /// Map of resolved path to index in `files`
+    map<string,size_t> index;
+};
+
+
+/**
+ @brief Resolve an included filename relative to the file including it
+
+ ## Resolve an included filename relative to the file including it
+
+ ### Arguments
+ - `string parent` - Path of the file containing the `Include` line
+ - `string reference` - Filename as written after `Include`
+*/
+string resolveInclude(string parent, string reference){
+    if(reference.empty() || reference[0]=='/') return reference;
+    size_t slash = parent.find_last_of('/');
+    return ((slash==string::npos)?string("."):parent.substr(0,slash))+"/"+reference;
+}
+
+
+/**
+ @brief Read a whole file through a memory mapping
+
+ ## Read a whole file through a memory mapping
+
+ ### Arguments
+ - `string path` - File to read
+ - `string& text` - Contents of the file, with a newline appended if the last line has none (return by reference)
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+*/
+bool geoRead(string path, string& text){
+    int file = open(path.c_str(),O_RDONLY);
+    if(file<0) return 1;
+    struct stat status;
+    if(fstat(file,&status)!=0 || !S_ISREG(status.st_mode)){
+        close(file);
+        return 1;
+    }
+    text.clear();
+    if(status.st_size>0){
+        void* data = mmap(NULL,status.st_size,PROT_READ,MAP_PRIVATE,file,0);
+        if(data==MAP_FAILED){
+            close(file);
+            return 1;
+        }
+        madvise(data,status.st_size,MADV_SEQUENTIAL);
+        text.assign((const char*)data,status.st_size);
+        munmap(data,status.st_size);
+    }
+    close(file);
+    if(!text.empty() && text.back()!='\n') text += '\n';
+    return 0;
+}
+
+
+/**
+ @brief Whether a line is an `Include` line
+
+ ## Whether a line is an `Include` line
+
+ ### Arguments
+ - `const string& text` - Text containing the line
+ - `size_t begin` - Offset of the start of the line
+ - `string& reference` - Included file, as written after `Include` (return by reference)
+
+ ### Notes
+ Same as reading the first two words of the line with a stringstream, without building one for every line.
+*/
+bool geoInclude(const string& text, size_t begin, string& reference){
+    size_t end = text.find('\n',begin);
+    if(end==string::npos) end = text.size();
+    size_t position = begin;
+    while(position<end && isspace((unsigned char)text[position])) position++;
+    if(end-position<7 || text.compare(position,7,"Include")!=0 || (position+7<end && !isspace((unsigned char)text[position+7]))) return 0;
+    position += 7;
+    while(position<end && isspace((unsigned char)text[position])) position++;
+    size_t start = position;
+    while(position<end && !isspace((unsigned char)text[position])) position++;
+    reference = text.substr(start,position-start);
+    return 1;
+}
+
+
+/**
+ @brief Load a geometry and all files it includes into memory
+
+ ## Load a geometry and all files it includes into memory
+
+ ### Arguments
+ - `string inputFile` - Input filename
+ - `string reference` - Reference used to include the file
+ - `geoTree& tree` - Tree to load the files into
+
+ ### Return value
+ Returns the index of the file in `tree.files`, or -1 on failure.
+
+ ### Notes
+ The include graph is resolved one level at a time: every file of a level is read (see `geoRead`) and scanned for includes in parallel, then the files it includes that were never seen make up the next level. Each distinct file is read exactly once, however many times it is included. Include cycles are reported (with the files involved) instead of being followed.
+*/
+int engine::geoLoad(string inputFile, string reference, geoTree& tree){
+    // Includes found in each file, as (line, reference, path to open, resolved path)
+    vector<vector<tuple<size_t,string,string,string>>> found(tree.files.size());
+    auto add = [&](string opened, string reference, string path){
+        auto known = tree.index.find(path);
+        if(known!=tree.index.end()) return known->second;
+        tree.index[path] = tree.files.size();
+        tree.files.push_back(geoFile());
+        tree.files.back().path = path;
+        tree.files.back().opened = opened;
+        tree.files.back().reference = reference;
+        found.emplace_back();
+        return tree.files.size()-1;
+    };
+    char resolved[PATH_MAX];
+    size_t known = tree.files.size();
+    size_t root = add(inputFile,reference,(realpath(inputFile.c_str(),resolved)!=NULL)?string(resolved):inputFile);
+    vector<size_t> level;
+    if(root>=known) level.push_back(root);
+
+    while(!level.empty()){
+        // Read and scan every file of this level
+        atomic<size_t> next(0);
+        atomic<bool> failed(false);
+        auto scan = [&](){
+            char resolved[PATH_MAX];
+            for(size_t n;(n=next++)<level.size();){
+                geoFile& file = tree.files[level[n]];
+                if(geoRead(file.opened,file.text)){
+                    quickSlack("GEOLOAD: Could not open included file \"" + file.opened + "\".",1);
+                    failed = 1;
+                    continue;
+                }
+                for(size_t i=0;i<file.text.size();i=file.text.find('\n',i)+1) file.lines.push_back(i);
+                for(size_t i=0;i<file.lines.size();i++){
+                    string included;
+                    if(!geoInclude(file.text,file.lines[i],included)) continue;
+                    if(included.empty()){
+                        quickSlack("GEOLOAD: Include without a file in \"" + file.opened + "\", line "+to_string(i+1)+".",1);
+                        failed = 1;
+                        break;
+                    }
+                    string opened = resolveInclude(file.opened,included);
+                    found[level[n]].push_back(make_tuple(i,included,opened,(realpath(opened.c_str(),resolved)!=NULL)?string(resolved):opened));
+                }
+            }
+        };
+        vector<thread> scanners;
+        for(size_t i=0;i<min(level.size(),(size_t)16);i++) scanners.push_back(thread(scan));
+        for(auto& scanner:scanners) scanner.join();
+        if(failed) return -1;
+
+        // Index the files they include, in include order
+        vector<size_t> nextLevel;
+        for(auto& parent:level){
+            for(auto& include:found[parent]){
+                size_t before = tree.files.size();
+                size_t child = add(get<2>(include),get<1>(include),get<3>(include));
+                tree.files[parent].includes.push_back(make_pair(get<0>(include),child));
+                if(child==before) nextLevel.push_back(child);
+            }
+        }
+        level.swap(nextLevel);
+    }
+
+    // Detect include cycles
+    vector<int> state(tree.files.size(),0);
+    vector<size_t> chain;
+    string cycle;
+    function<bool(size_t)> visit = [&](size_t file){
+        state[file] = 1;
+        chain.push_back(file);
+        for(auto& include:tree.files[file].includes){
+            if(state[include.second]==1){
+                for(size_t i=find(chain.begin(),chain.end(),include.second)-chain.begin();i<chain.size();i++) cycle += tree.files[chain[i]].path+" -> ";
+                cycle += tree.files[include.second].path;
+                return true;
+            }
+            if(state[include.second]==0 && visit(include.second)) return true;
+        }
+        chain.pop_back();
+        state[file] = 2;
+        return false;
+    };
+    if(visit(root)){
+        quickSlack("GEOLOAD: Include cycle: "+cycle+". Exiting.",1);
+        return -1;
+    }
+    return root;
+}
+
+
+/**
+ @brief Write a loaded file, with all the files it includes, to a stream
+
+ ## Write a loaded file, with all the files it includes, to a stream
+
+ ### Arguments
+ - `geoTree& tree` - Loaded geometry
+ - `size_t index` - Index of the file to write
+ - `ostream& out` - Output stream
+
+ ### Notes
+ Everything between two `Include` lines is written as a single span of the cached file. Each `Include` line is commented out and followed by the included file, up to a `///End <reference>` line.
+*/
+void geoEmit(geoTree& tree, size_t index, ostream& out){
+    geoFile& file = tree.files[index];
+    size_t from = 0;
+    for(auto& include:file.includes){
+        size_t begin = file.lines[include.first];
+        size_t end = (include.first+1<file.lines.size())?file.lines[include.first+1]:file.text.size();
+        out.write(file.text.data()+from,begin-from);
+        out << "///";
+        out.write(file.text.data()+begin,end-begin);
+        geoEmit(tree,include.second,out);
+        string reference;
+        geoInclude(file.text,begin,reference);
+        out << "///End " << reference << "\n";
+        from = end;
+    }
+    out.write(file.text.data()+from,file.text.size()-from);
+}
+
+
+/**
+ @brief Outputs input file with all included files fully evaluated
+
+ ## Output input file with all included files fully evaluated
+
+ ### Arguments
+ - `string inputFile` - Input filename
+ - `ostream& out` - Output stream
+ - `geoTree& tree` - Include tree of the geometry, loaded by `geoLoad` if it is empty (and kept, so variants can be generated from memory)
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Every file is read once (see `geoLoad`), but written every time it is included.
+*/
+int engine::geoMerge(string inputFile, ostream& out, geoTree& tree){
+    if(tree.files.empty() && geoLoad(inputFile,inputFile,tree)<0) return 1;
+    out << "///Include " << inputFile << "\n"; // Note initial file
+    geoEmit(tree,0,out);
+    out << "///End " << inputFile << "\n"; // Note final file
+    return 0;
+}
+
+
+/**
+ @brief Find the file a geomega parameter refers to
+
+ ## Find the file a geomega parameter refers to
+
+ ### Arguments
+ - `geoTree& tree` - Loaded geometry
+ - `string reference` - Filename as given in the parameter (formatted however it is referenced when included)
+
+ ### Return value
+ Index of the first file (in include order) matching the reference, or -1 if it is never included.
+*/
+int geoFind(geoTree& tree, string reference, size_t file=0, vector<bool>* visited=NULL){
+    vector<bool> localVisited;
+    if(visited==NULL){
+        if(tree.files.empty()) return -1;
+        if(tree.files[0].reference==reference) return 0;
+        localVisited.resize(tree.files.size(),0);
+        visited=&localVisited;
+    }
+    if((*visited)[file]) return -1;
+    (*visited)[file]=1;
+    for(auto& include:tree.files[file].includes){
+        if(tree.files[include.second].reference==reference) return include.second;
+        int found = geoFind(tree,reference,include.second,visited);
+        if(found>=0) return found;
+    }
+    return -1;
+}
+
+
+/**
+ @brief Write a geometry variant as an overlay on the original files
+
+ ## Write a geometry variant as an overlay on the original files
+
+ ### Arguments
+ - `geoTree& tree` - Loaded geometry
+ - `map<size_t,map<size_t,string>>& changes` - Replacement lines, indexed by file and (zero indexed) line
+ - `string prefix` - Prefix of the variant, eg `g.0.1`
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Only the modified files, and the files that (directly or indirectly) include them, are written. They are named `prefix.<file index>.<original name>`, except for the top level file which is named `prefix.geo.setup`. Every other `Include` line is pointed at the original, unmodified file.
+
+ Unlike merged variants, a modified file is modified everywhere it is included, not only at its first inclusion.
+*/
+int engine::geoOverlay(geoTree& tree, map<size_t,map<size_t,string>>& changes, string prefix){
+    // Mark every file that needs to be rewritten, ie. changed files and everything including them
+    vector<bool> rewrite(tree.files.size(),0);
+    for(auto& c:changes) rewrite[c.first]=1;
+    for(bool updated=1;updated;){
+        updated=0;
+        for(size_t i=0;i<tree.files.size();i++){
+            if(rewrite[i]) continue;
+            for(auto& include:tree.files[i].includes) if(rewrite[include.second]){ rewrite[i]=updated=1; break; }
+        }
+    }
+    rewrite[0]=1;
+
+    vector<string> names(tree.files.size());
+    for(size_t i=0;i<tree.files.size();i++){
+        if(!rewrite[i]) names[i]=tree.files[i].path;
+        else if(i==0) names[i]=absolutePath(prefix+".geo.setup");
+        else names[i]=absolutePath(prefix+"."+to_string(i)+"."+tree.files[i].path.substr(tree.files[i].path.find_last_of('/')+1));
+    }
+
+    for(size_t i=0;i<tree.files.size();i++){
+        if(!rewrite[i]) continue;
+        map<size_t,string> lineChanges;
+        if(changes.count(i)) lineChanges = changes[i];
+        for(auto& include:tree.files[i].includes) if(!lineChanges.count(include.first)) lineChanges[include.first]="Include "+names[include.second];
+
+        ofstream out(names[i]);
+        if(!out.is_open()){
+            quickSlack("GEOMEGA SETUP: Could not create overlay file \""+names[i]+"\".",1);
+            return 1;
+        }
+        // Unchanged lines are written as spans of the cached file
+        geoFile& file = tree.files[i];
+        size_t from = 0;
+        for(auto& change:lineChanges){
+            out.write(file.text.data()+from,file.lines[change.first]-from);
+            out << change.second << "\n";
+            from = (change.first+1<file.lines.size())?file.lines[change.first+1]:file.text.size();
+        }
+        out.write(file.text.data()+from,file.text.size()-from);
+        out.close();
+    }
+    return 0;
+}
+
+
+/**
+ @brief Refinement level of one option of a parameter
+
+ ## Refinement level of one option of a parameter
+
+ ### Arguments
+ - `size_t option` - Index of the option
+ - `size_t options` - Number of options
+
+ ### Return value
+ Returns the smallest level whose grid contains the option: level 0 holds the first and last options, and every level halves the spacing of the previous one (level 1 adds the middle option, level 2 the quarters, and so on)
+*/
+int refinementLevel(size_t option, size_t options){
+    if(option==0 || option+1>=options) return 0;
+    for(int level=1;;level++){
+        double step = (double)(options-1)/(1<<level);
+        if(step<=1 || llround(llround(option/step)*step)==(long long)option) return level;
+    }
+}
+
+
+/**
+ @brief Refinement level of a run
+
+ ## Refinement level of a run
+
+ ### Arguments
+ - `int runNumber` - Run number
+
+ ### Return value
+ Returns the highest refinement level (see `refinementLevel`) of the options of the run, over every geometry and source parameter
+
+ ### Notes
+ Runs of level 0 are the corners of the parameter space, and every level fills the gaps left by the previous ones.
+*/
+int engine::runLevel(int runNumber){
+    if(!reprocessCatalog.empty() || geometryCount<1) return 0;
+    int level = 0;
+    // Same decomposition as catalogValues: the geometry varies fastest in the run number, its first parameter slowest
+    int indexes[2] = {runNumber%geometryCount, runNumber/geometryCount};
+    vector<parameter>* sets[2] = {&geometryParameters, &sourceParameters};
+    for(int s=0;s<2;s++){
+        vector<parameter>& parameters = *sets[s];
+        int index = indexes[s];
+        for(size_t n=0;n<parameters.size();n++){
+            parameter& p = parameters[(s==1)?n:parameters.size()-1-n];
+            if(p.options.empty()) continue;
+            level = max(level,refinementLevel(index%p.options.size(),p.options.size()));
+            index /= p.options.size();
+        }
+    }
+    return level;
+}
+
+
+/**
+ @brief Add a run to the run queue
+
+ ## Add a run to the run queue
+
+ ### Arguments
+ - `string source` - Source file of the run
+ - `int runNumber` - Run number
+
+ ### Notes
+ Must be called with `queueLock` held. With a deadline (and `deadlineOrder`), the queue is kept sorted by refinement level (see `runLevel`), so the whole parameter space is covered coarsely before it is refined. Within a level, runs of the same geometry variant stay together. Otherwise runs are queued in order, which already keeps the runs of each variant together (see `writeSources`).
+*/
+void engine::queueRun(string source, int runNumber){
+    if(deadlineTime==0 || !deadlineOrder){
+        runQueue.push_back(make_pair(source,runNumber));
+        return;
+    }
+    auto key = [this](int run){ return make_pair(runLevel(run),(geometryCount>0)?run%geometryCount:0); };
+    auto position = upper_bound(runQueue.begin(),runQueue.end(),key(runNumber),[&](const pair<int,int>& value, const pair<string,int>& run){ return value<key(run.second); });
+    runQueue.insert(position,make_pair(source,runNumber));
+}
+
+
+/**
+ @brief Queue a run for every source template using the given geometry
+
+ ## Write the run?.source files for one geometry and queue them
+
+ ### Arguments
+ - `string geometry` - Geometry file to use (if empty, the geometry of the base source file is kept)
+ - `int geometryIndex` - Index of the geometry variant, used to number the runs
+
+ ### Notes
+ Runs are numbered with the geometry varying fastest, so run numbers do not depend on the order geometries finish their checks in. Runs of invalid geometries are never written, which leaves gaps in the numbering. The runs of a geometry are queued together, so they are dispatched together and share its files in the page cache (see `warmGeometry`).
+*/
+void engine::writeSources(string geometry, int geometryIndex){
+    for(size_t i=0;i<sourceTemplates.size();i++){
+        int runNumber = i*geometryCount+geometryIndex;
+        string directory = runDirectory(runNumber);
+        string filename = ((directory==".")?string(""):directory+"/")+"run"+to_string(runNumber)+".source";
+
+        // Fix geometry and output filename
+        string updated = sourceTemplates[i];
+        if(!geometry.empty()){
+            regex g("(^|\n)Geometry.*\n");
+            updated = regex_replace(updated,g,"$1Geometry "+geometry+"\n");
+        }
+        // Simulations run somewhere else, so the geometry needs an absolute path
+        if(runDirectories || !scratch.empty() || speculation){
+            smatch m;
+            regex g("(^|\n)Geometry[ \t]+(\\S+)");
+            if(regex_search(updated,m,g) && m[2].str()[0]!='/') updated = m.prefix().str()+m[1].str()+"Geometry "+absolutePath(m[2].str())+m.suffix().str();
+        }
+        regex e(".FileName.*\n");
+        updated = regex_replace(updated,e,".FileName run"+to_string(runNumber)+"\n");
+
+        // Update Triggers, Events, or Time
+        if(!sourceTiming[0].empty()){
+            regex t("\\..?"+sourceTiming[0]+".*\n");
+            updated = regex_replace(updated,t,"."+sourceTiming[0]+" "+sourceTiming[1]+"\n");
+        }
+
+        if(makeDirectory(directory)) quickSlack("WRITE SOURCES: Could not create directory \""+directory+"\".",1);
+        ofstream out(filename);
+        out << updated;
+        out.close();
+
+        string columns, values;
+        catalogValues(geometryParameters,geometryIndex,0,columns,values);
+        catalogValues(sourceParameters,i,1,columns,values);
+        catalogPost("INSERT INTO runs(run_id,geometry_id,source,directory,status,timing_value,timing_fraction"+columns+") VALUES ("+to_string(runNumber)+","+(geometry.empty()?string("NULL"):to_string(geometryIndex))+","+sqlQuote(filename)+","+sqlQuote(directory)+",'queued',"+(sourceTiming[0].empty()?string("NULL"):sqlQuote(sourceTiming[1]))+",1"+values+")");
+
+        queueLock.lock();
+        geometryFiles[geometryIndex] = geometry.empty()?string(""):absolutePath(geometry);
+        queueRun(filename,runNumber);
+        queueLock.unlock();
+    }
+}
+
+
+/**
+ @brief Write the lines a geometry variant alters, compared to the reference variant
+
+ ## Write the lines a geometry variant alters, compared to the reference variant
+
+ ### Arguments
+ - `string filename` - File to write
+ - `int geometryIndex` - Index of the geometry variant
+ - `int reference` - Index of the reference variant
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Both versions of every altered line are written (the reference one first), so checkGeometry can find the volumes they describe in either variant. Parameters with the same value in both variants are left out.
+*/
+bool engine::writeChanges(string filename, int geometryIndex, int reference){
+    ofstream out(filename);
+    if(!out.is_open()) return 1;
+    for(size_t n=0;n<geometryParameters.size();n++){
+        parameter& p = geometryParameters[geometryParameters.size()-1-n];
+        if(p.options.empty()) continue;
+        size_t option = geometryIndex%p.options.size(), referenceOption = reference%p.options.size();
+        geometryIndex /= p.options.size();
+        reference /= p.options.size();
+        if(option!=referenceOption) out << p.options[referenceOption] << "\n" << p.options[option] << "\n";
+    }
+    out.close();
+    return !out.good();
+}
+
+
+/**
+
+ @brief Check geometry file using checkGeometry
+
+ ## Check geometry file using checkGeometry
+
+ ### Arguments
+ - `string filename` - Geometry file to test
+ - `int geometryIndex` - Index of the geometry variant
+
+ ### Notes
+ If the geometry is valid, its runs are immediately queued for simulation. Otherwise they are dropped from the totals.
+
+ With `incrementalChecks`, once a variant passed a full check, the other variants only differ from it by the parameter lines, so checkGeometry is only asked to check the volumes those lines alter (see `writeChanges`). It falls back to a full check by itself if they alter the volume hierarchy.
+*/
+void engine::testGeometry(string filename, int geometryIndex){
+    int reference = referenceGeometry;
+    string changes = filename+".changed";
+    if(reference>=0 && writeChanges(changes,geometryIndex,reference)){
+        quickSlack("GEOMEGA: Could not write \""+changes+"\". Running a full check.",2);
+        reference = -1;
+    }
+    int slot = placementAcquire();
+    int status=runCommand(checkGeometry+" "+((reference>=0)?"--changed "+changes+" ":string(""))+filename+" > /dev/null 2> /dev/null");
+    placementRelease(slot);
+    if(reference>=0) remove(changes.c_str());
+    if(status){
+        quickSlack("GEOMEGA: Geometry error in geometry \""+filename+"\". Removing geometry from list.",1);
+        catalogPost("UPDATE geometries SET status='invalid',checked="+string((reference>=0)?"'incremental'":"'full'")+" WHERE geometry_id="+to_string(geometryIndex));
+        statusBar[2]--;
+        statusBar[5]-=sourceTemplates.size();
+        statusBar[8]-=sourceTemplates.size();
+    } else {
+        catalogPost("UPDATE geometries SET status='valid',checked="+string((reference>=0)?"'incremental'":"'full'")+" WHERE geometry_id="+to_string(geometryIndex));
+        statusBar[1]++;
+        int none = -1;
+        if(incrementalChecks && reference<0) referenceGeometry.compare_exchange_strong(none,geometryIndex);
+        writeSources(filename,geometryIndex);
+    }
+    currentThreadCount--;
+}
+
+
+/**
+ @brief Parsed geomega settings
+
+ ## Parsed geomega settings
+
+ ### Notes
+ Entry `i` of `files`, `lines` and `options` describe the same parameter.
+*/
+struct geomegaParameters {
+    /// Base .geo.setup file
+    string filename;
+    /// Write overlays instead of merged copies
+    bool overlay = 0;
+    /// Files to alter
+    vector<string> files;
+    /// Line numbers to alter
+    vector<int> lines;
+    /// Possible contents of each line
+    vector<vector<string>> options;
+};
+
+
+/**
+ @brief Parse geomega settings
+
+ ## Parse geomega settings
+
+ ### Arguments
+ - `YAML::NODE geomega` - Geomega node to parse settings from
+ - `geomegaParameters& parameters` - Parsed settings (return by reference)
+
+ ### Return value
+ Returns the success value: 0 for success, return code otherwise
+
+ ### Notes
+ Also sets `geometryCount` to the number of variants that will be generated.
+*/
+int engine::geomegaParse(YAML::Node geomega, geomegaParameters& parameters){
+    parameters.filename = geomega["filename"].as<string>();
+    parameters.overlay = geomega["overlay"] && geomega["overlay"].as<bool>();
+    incrementalChecks = geomega["incrementalChecks"] && geomega["incrementalChecks"].as<bool>();
+    vector<string>& files = parameters.files;
+    vector<int>& lines = parameters.lines;
+    vector<vector<string>>& options = parameters.options;
+
+    // Generate all options
+    if(geomega["parameters"].size()!=0){
+        for(YAML::const_iterator it=geomega["parameters"].begin();it != geomega["parameters"].end();++it){
+            auto location = std::find(files.begin(), files.end(), it->second["filename"].as<string>());
+            if(location != files.end() && lines[location-files.begin()]==it->second["lineNumber"].as<int>()){
+                quickSlack("GEOMEGA SETUP: Multiple parameters alter the same line in the file. Exiting.");
+                return 4;
+            }
+
+            files.push_back(it->second["filename"].as<string>());
+            lines.push_back(it->second["lineNumber"].as<int>());
+            parameter p;
+            p.name = it->first.as<string>();
+            p.file = files.back();
+            p.line = lines.back();
+            p.options = parseIterativeNode(it->second["contents"],"",&p.elements,&p.numeric);
+            options.push_back(p.options);
+            geometryParameters.push_back(p);
+            if(exitFlag) return 6;
+        }
+
+        for(size_t i=0;i<options.size();i++){
+            for(size_t j=0;j<options[i].size();j++){
+                if(options[i][j].find('\n') != std::string::npos){
+                    quickSlack("GEOMEGA SETUP: One or more parameters include newlines. This creates undefined behavior. Exiting.");
+                    return 5;
+                }
+            }
+        }
+    }
+
+    int count = 1;
+    for(auto& o:options) count*=o.size();
+    geometryCount = count;
+    return 0;
+}
+
+
+/**
+ @brief Queue a geometry variant for checking
+
+ ## Queue a geometry variant for checking
+
+ ### Arguments
+ - `string filename` - Geometry file to check
+ - `int geometryIndex` - Index of the geometry variant
+*/
+void engine::queueGeometry(string filename, int geometryIndex){
+    string columns, values;
+    catalogValues(geometryParameters,geometryIndex,0,columns,values);
+    catalogPost("INSERT INTO geometries(geometry_id,file,status"+columns+") VALUES ("+to_string(geometryIndex)+","+sqlQuote(filename)+",'generated'"+values+")");
+
+    queueLock.lock();
+    checkQueue.push_back(make_pair(filename,geometryIndex));
+    queueLock.unlock();
+}
+
+
+/**
+ @brief Locate the lines altered by the geomega parameters in the merged geometry
+
+ ## Locate the lines altered by the geomega parameters in the merged geometry
+
+ ### Arguments
+ - `const string& merged` - Merged geometry (see `geoMerge`)
+ - `const vector<size_t>& mergedLines` - Offset of the start of every line of `merged`
+ - `vector<string>& files` - File altered by each parameter, as referenced when included
+ - `vector<int>& lines` - Line altered by each parameter (one indexed, within its file)
+ - `map<size_t,size_t>& targets` - Parameter altering each merged line, by (zero indexed) merged line (return by reference)
+
+ ### Return value
+ Returns the success value: 0 for success, return code otherwise
+
+ ### Notes
+ The line is searched for in the first inclusion of the file, not counting the lines of the files it includes. Done once, so every variant is written straight from memory. If two parameters end up on the same line, the last one wins.
+*/
+int engine::geoLocate(const string& merged, const vector<size_t>& mergedLines, vector<string>& files, vector<int>& lines, map<size_t,size_t>& targets){
+    auto line = [&](size_t i){
+        size_t end = ((i+1<mergedLines.size())?mergedLines[i+1]:merged.size())-1;
+        return merged.substr(mergedLines[i],end-mergedLines[i]);
+    };
+    for(size_t i=0;i<files.size();i++){
+        // Seek to "///Include "+files[i]
+        size_t k = 0;
+        while(k<mergedLines.size() && line(k)!="///Include "+files[i]) k++;
+        if(k==mergedLines.size()){
+            quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
+            return 5;
+        }
+        k++;
+
+        // Seek lines[i] lines ahead, skipping over other includes
+        for(int j=0;j<lines[i]-1;j++){
+            if(k>=mergedLines.size() || line(k)=="///End "+files[i]){
+                quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
+                return 4;
+            }
+            stringstream newLine(line(k++));
+            string command,file; newLine >> command >> file;
+            if(command!="///Include") continue;
+            while(1){
+                if(k>=mergedLines.size() || line(k)=="///End "+files[i]){
+                    quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
+                    return 4;
+                }
+                if(line(k++)=="///End "+file) break;
+            }
+        }
+        if(k>=mergedLines.size() || line(k)=="///End "+files[i]){
+            quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
+            return 4;
+        }
+        targets[k] = i;
+    }
+    return 0;
+}
+
+
+/**
+ @brief Setup .geo.setup files
+
+ ## Setup .geo.setup files
+
+ ### Arguments
+ - `geomegaParameters& parameters` - Parsed geomega settings
+
+ ### Return value
+ Returns the success value: 0 for success, return code otherwise
+
+ ### Notes
+ Merges all dependencies into a single file, my default g.geo.setup, then creates additional files from there. In my experience this has worked fine, but let me know if there is a problem with your geometry. The merged file is kept in memory, and the lines to alter are located once (see `geoLocate`), so each variant is written without rereading anything.
+
+ If `overlay` is set, nothing is merged. Each variant only writes the files it modifies (and those including them), see `geoOverlay`.
+
+ Meant to be run in its own thread. Each variant is queued for checking as soon as it is written, so checks (and simulations) start before all variants exist.
+*/
+int engine::geomegaSetup(geomegaParameters& parameters){
+    // Update status
+    statusBar[0]=1;
+    bool overlay = parameters.overlay;
+    vector<string>& files = parameters.files;
+    vector<int>& lines = parameters.lines;
+    vector<vector<string>>& options = parameters.options;
+
+    // Merge all files together, or load them for overlays
+    geoTree tree;
+    string merged;
+    vector<size_t> mergedLines;
+    if(overlay){
+        if(geoLoad(parameters.filename,parameters.filename,tree)<0) return 1;
+    } else {
+        ofstream baseGeometry("g.geo.setup");
+        if(!baseGeometry.is_open()){quickSlack("GEOMEGA SETUP: Could not create new base geometry file. Exiting.",1); return 3;}
+        stringstream mergedGeometry;
+        if(geoMerge(parameters.filename,mergedGeometry,tree)) return 1;
+        merged = mergedGeometry.str();
+        baseGeometry << merged;
+        baseGeometry.close();
+        for(size_t i=0;i<merged.size();i=merged.find('\n',i)+1) mergedLines.push_back(i);
+    }
+
+    // Generate all variants, queueing each for checking as soon as it is written
+    int geometryIndex = 0;
+    if(options.size()!=0){
+        // Locate the lines to alter in the merged geometry, or the files to alter in the include tree
+        map<size_t,size_t> mergedTargets;
+        if(!overlay){
+            int status = geoLocate(merged,mergedLines,files,lines,mergedTargets);
+            if(status) return status;
+        }
+        vector<int> targets;
+        if(overlay) for(size_t i=0;i<files.size();i++){
+            targets.push_back(geoFind(tree,files[i]));
+            if(targets[i]<0){
+                quickSlack("GEOMEGA SETUP: File \""+files[i]+"\" is never included. Exiting.",1);
+                return 5;
+            }
+            if(lines[i]<1 || (size_t)lines[i]>tree.files[targets[i]].lines.size()){
+                quickSlack("GEOMEGA SETUP: Attempted to alter line number past end of file. File: "+files[i],1);
+                return 4;
+            }
+        }
+
+
+        // Create new files
+        vector<size_t> odometer(lines.size(),0);
+        int position=odometer.size()-1;
+        while(position>=0 && !draining && !interrupted){
+            if(odometer[position]==options[position].size()){
+                odometer[position]=0;
+                if(--position<0) break;
+                odometer[position]++;
+            } else {
+                // Write only the altered files
+                if(overlay){
+                    string prefix = "g";
+                    for(auto& o:odometer) prefix+="."+to_string(o);
+                    map<size_t,map<size_t,string>> changes;
+                    for(size_t i=0;i<odometer.size();i++) changes[targets[i]][lines[i]-1]=options[i][odometer[i]];
+                    if(geoOverlay(tree,changes,prefix)) return 3;
+                    queueGeometry(prefix+".geo.setup",geometryIndex++);
+
+                    // Manage odometer
+                    position=odometer.size()-1;
+                    odometer[position]++;
+                    continue;
+                }
+
+                // Write the merged geometry, replacing the altered lines
+                string fileName = "g";
+                for(auto& o:odometer) fileName+="."+to_string(o);
+                fileName+=".geo.setup";
+                ofstream newGeometry(fileName);
+                size_t from = 0;
+                for(auto& target:mergedTargets){
+                    newGeometry.write(merged.data()+from,mergedLines[target.first]-from);
+                    newGeometry << options[target.second][odometer[target.second]] << "\n";
+                    from = (target.first+1<mergedLines.size())?mergedLines[target.first+1]:merged.size();
+                }
+                newGeometry.write(merged.data()+from,merged.size()-from);
+                newGeometry.close();
+                queueGeometry(fileName,geometryIndex++);
+
+                // Manage odometer
+                position=odometer.size()-1;
+                odometer[position]++;
+            }
+        }
+    } else {
+        queueGeometry(overlay?tree.files[0].path:"g.geo.setup",geometryIndex++);
+    }
+
+    return 0;
+}
+
+
+/**
+ @brief Parse cosima settings and setup source templates
+
+ ## Parse cosima settings and setup source templates
+
+ ### Arguments
+ - `YAML::Node cosima` - Cosima node to parse settings from
+ - `bool templates` - Whether to build the source templates (otherwise only `sourceParameters` and `sourceTiming` are filled)
+
+ ### Return value
+ Returns the success value: 0 for success, return code otherwise.
+
+ ### Notes
+ Only replaces line in a source file, it does not add them as that would be undefined behavior. Make sure that all of your operations replace lines, otherwise they will not be parsed correctly. This may not always throw an error, so manually check that your iterations are properly parsing.
+
+ Fills `sourceTemplates` and `sourceTiming`. The run?.source files themselves are written by `writeSources` once their geometry has passed its check.
+*/
+int engine::cosimaSetup(YAML::Node cosima, bool templates){
+    // Update status
+    statusBar[3]=statusBar[6]=1;
+
+    // Make sure config file exists
+    string baseFileName = cosima["filename"].as<string>();
+    if(!fileExists(baseFileName)){
+        quickSlack("COSIMA SETUP: File \"" + baseFileName + "\" does not exist, but was requested. Exiting.",1);
+        return 1;
+    }
+
+    // Parse iterative nodes, but need to specially format them with the correct source and name.
+    map<string,vector<string>> options;
+    map<string,parameter> parsed;
+    const char* keywords[5] = {"beam","spectrum","flux","polarization","particleType"};
+    for(YAML::const_iterator it=cosima["parameters"].begin();it != cosima["parameters"].end();++it){
+        for(auto& keyword:keywords){
+            if(!it->second[keyword]) continue;
+            string name = it->second["source"].as<string>()+"."+(char)toupper(keyword[0])+string(keyword+1);
+            parameter& p = parsed[name];
+            p.name = name;
+            p.options = parseIterativeNode(it->second[keyword],name,&p.elements,&p.numeric);
+            options[name] = p.options;
+        }
+        if(exitFlag) return 6;
+    }
+    for(auto& p:parsed) sourceParameters.push_back(p.second);
+    string* timing = sourceTiming;
+    if(cosima["events"]){
+        if(timing[0]=="") {
+            timing[0]="Events"; timing[1]=cosima["events"].as<string>();
+        } else {
+            quickSlack("COSIMA SETUP: Multiple timing definitions. Exiting.",1);
+            return 1;
+        }
+    }
+    if(cosima["triggers"]){
+        if(timing[0]=="") {
+            timing[0]="Triggers"; timing[1]=cosima["triggers"].as<string>();
+        } else {
+            quickSlack("COSIMA SETUP: Multiple timing definitions. Exiting.",1);
+            return 1;
+        }
+    }
+    if(cosima["time"]){
+        if(timing[0]=="") {
+            timing[0]="Time"; timing[1]=cosima["time"].as<string>();
+        } else {
+            quickSlack("COSIMA SETUP: Multiple timing definitions. Exiting.",1);
+            return 1;
+        }
+    }
+    if(!templates) return 0;
+
+    // Read base geometry
+    ifstream baseSource(cosima["filename"].as<string>());
+    stringstream baseSourceStream;
+    copy(istreambuf_iterator<char>(baseSource),istreambuf_iterator<char>(),ostreambuf_iterator<char>(baseSourceStream));
+    vector<string> alteredSources;
+    alteredSources.push_back(baseSourceStream.str());
+
+    // Parse cosima parameters to create a bunch of base run?.source files
+    for(auto &elem:options){
+        vector<string> newSources;
+        for(auto &option:elem.second){
+            for(auto &s : alteredSources){
+                stringstream alteredSource(s);
+                stringstream newSource;
+                for(string line; getline(alteredSource,line);){
+                    stringstream ss(line);
+                    string command; ss >> command;
+                    if(command==elem.first){
+                        newSource << option << "\n";
+                    } else newSource << line << "\n";
+                }
+                newSources.push_back(newSource.str());
+            }
+        }
+        alteredSources.swap(newSources);
+    }
+
+    sourceTemplates.swap(alteredSources);
+    return 0;
+}
+
+
+/**
+ @brief Find the simulations of a previous campaign to reprocess
+
+ ## Find the simulations of a previous campaign to reprocess
+
+ ### Arguments
+ - `YAML::Node reprocess` - Reprocess node to parse settings from
+
+ ### Return value
+ Returns the success value: 0 for success, return code otherwise.
+
+ ### Notes
+ Reads the catalog of the previous campaign: its parameters are rebuilt into `geometryParameters` and `sourceParameters` (so the new catalog has the same columns), and every run with a kept .sim.gz file (and matching `where`, if given) is added to `reprocessRuns`. Relative paths in the previous catalog and source files are relative to the directory of the catalog.
+
+ Runs are kept with their original numbers. Each run is reprocessed with the geometry it was simulated with, unless `geometry` is given.
+*/
+int engine::reprocessSetup(YAML::Node reprocess){
+    // Update status
+    statusBar[6]=1;
+
+    if(!reprocess["catalog"]){
+        quickSlack("REPROCESS SETUP: No catalog given. Exiting.",1);
+        return 1;
+    }
+    reprocessCatalog = absolutePath(reprocess["catalog"].as<string>());
+    string base = reprocessCatalog.substr(0,reprocessCatalog.rfind('/'));
+    auto resolve = [&base](string path){ return (path.empty() || path[0]=='/')?path:base+"/"+path; };
+    if(reprocess["geometry"]){
+        reprocessGeometry = absolutePath(reprocess["geometry"].as<string>());
+        if(!fileExists(reprocessGeometry)){
+            quickSlack("REPROCESS SETUP: File \""+reprocessGeometry+"\" does not exist, but was requested. Exiting.",1);
+            return 1;
+        }
+    }
+    string where = reprocess["where"]?"("+reprocess["where"].as<string>()+")":"1";
+
+    sqlite3* previous = NULL;
+    if(!fileExists(reprocessCatalog) || sqlite3_open_v2(("file:"+reprocessCatalog+"?immutable=1").c_str(),&previous,SQLITE_OPEN_READONLY|SQLITE_OPEN_URI,NULL)!=SQLITE_OK){
+        sqlite3_close(previous);
+        quickSlack("REPROCESS SETUP: Could not open catalog \""+reprocessCatalog+"\". Exiting.",1);
+        return 1;
+    }
+
+    // Rebuild the parameters, in the order they were described in
+    sqlite3_stmt* statement = NULL;
+    map<string,bool> numeric;
+    if(sqlite3_prepare_v2(previous,"PRAGMA table_info(runs)",-1,&statement,NULL)==SQLITE_OK){
+        while(sqlite3_step(statement)==SQLITE_ROW) numeric[(const char*)sqlite3_column_text(statement,1)] = string((const char*)sqlite3_column_text(statement,2))=="REAL";
+    }
+    sqlite3_finalize(statement);
+    if(sqlite3_prepare_v2(previous,"SELECT name,parameter,element,file,line FROM parameters ORDER BY rowid",-1,&statement,NULL)==SQLITE_OK){
+        while(sqlite3_step(statement)==SQLITE_ROW){
+            string column = (const char*)sqlite3_column_text(statement,0);
+            vector<parameter>& set = (column.compare(0,4,"geo_")==0)?geometryParameters:sourceParameters;
+            if(sqlite3_column_type(statement,2)==SQLITE_NULL){
+                parameter p;
+                p.name = (const char*)sqlite3_column_text(statement,1);
+                if(sqlite3_column_type(statement,3)!=SQLITE_NULL) p.file = (const char*)sqlite3_column_text(statement,3);
+                p.line = sqlite3_column_int(statement,4);
+                set.push_back(p);
+            } else if(!set.empty()){
+                size_t element = sqlite3_column_int(statement,2);
+                parameter& p = set.back();
+                if(p.varying.size()<=element){ p.varying.resize(element+1,0); p.numeric.resize(element+1,0); }
+                p.varying[element] = 1;
+                p.numeric[element] = numeric[column];
+            }
+        }
+    }
+    sqlite3_finalize(statement);
+
+    // Find the kept simulations
+    int missing = 0;
+    if(sqlite3_prepare_v2(previous,("SELECT run_id,sim,source FROM runs WHERE sim IS NOT NULL AND sim!='' AND "+where+" ORDER BY run_id").c_str(),-1,&statement,NULL)!=SQLITE_OK){
+        quickSlack("REPROCESS SETUP: Could not select runs from \""+reprocessCatalog+"\": "+sqlite3_errmsg(previous)+". Exiting.",1);
+        sqlite3_finalize(statement);
+        sqlite3_close(previous);
+        return 1;
+    }
+    while(sqlite3_step(statement)==SQLITE_ROW){
+        int run = sqlite3_column_int(statement,0);
+        string sim = resolve((const char*)sqlite3_column_text(statement,1));
+        if(!fileExists(sim)){
+            missing++;
+            continue;
+        }
+        string geometry = reprocessGeometry;
+        if(geometry.empty() && sqlite3_column_type(statement,2)!=SQLITE_NULL){
+            ifstream sourceFile(resolve((const char*)sqlite3_column_text(statement,2)));
+            for(string line; geometry.empty() && getline(sourceFile,line);){
+                stringstream ss(line);
+                string command; ss >> command;
+                if(command=="Geometry") ss >> geometry;
+            }
+            geometry = resolve(geometry);
+        }
+        if(geometry.empty()){
+            missing++;
+            continue;
+        }
+        reprocessRuns[run] = make_pair(sim,geometry);
+    }
+    sqlite3_finalize(statement);
+    sqlite3_close(previous);
+
+    if(missing) quickSlack("REPROCESS SETUP: "+to_string(missing)+" kept simulations (or their geometries) could not be found, and will not be reprocessed.",1);
+    if(reprocessRuns.empty()){
+        quickSlack("REPROCESS SETUP: No simulations to reprocess in \""+reprocessCatalog+"\". Exiting.",1);
+        return 1;
+    }
+    statusBar[8]=reprocessRuns.size();
+    return 0;
+}
+
+
+/**
+ @brief Copy the reprocessed runs into the catalog, and queue them
+
+ ## Copy the reprocessed runs into the catalog, and queue them
+
+ ### Arguments
+ - `YAML::Node reprocess` - Reprocess node, as given to `reprocessSetup`
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Must be called after `catalogOpen`, and before `catalogWriter` starts. Geometries and runs (with their original seeds and parameter values) are copied from the previous catalog, with absolute paths. Runs whose simulation (or geometry) could not be found are marked `missing`.
+*/
+bool engine::reprocessQueue(YAML::Node reprocess){
+    string where = reprocess["where"]?"("+reprocess["where"].as<string>()+")":"1";
+    string base = reprocessCatalog.substr(0,reprocessCatalog.rfind('/'));
+    auto resolve = [&base](string column){ return "CASE WHEN substr("+column+",1,1)='/' THEN "+column+" ELSE "+sqlQuote(base+"/")+"||"+column+" END"; };
+    string geometryColumns, runColumns;
+    for(auto* set:{&geometryParameters,&sourceParameters}){
+        for(auto& p:*set){
+            string columns = ","+p.column;
+            for(size_t i=0;i<p.varying.size();i++) if(p.varying[i]) columns += ","+p.column+"_"+to_string(i);
+            if(set==&geometryParameters) geometryColumns += columns;
+            runColumns += columns;
+        }
+    }
+    string sql = "ATTACH DATABASE "+sqlQuote(reprocessCatalog)+" AS previous;"
+        "INSERT INTO geometries(geometry_id,file,status"+geometryColumns+") SELECT geometry_id,"+resolve("file")+",status"+geometryColumns+" FROM previous.geometries;"
+        "INSERT INTO runs(run_id,geometry_id,source,seed,sim,status"+runColumns+") SELECT run_id,geometry_id,"+resolve("source")+",seed,"+resolve("sim")+",'missing'"+runColumns+" FROM previous.runs WHERE sim IS NOT NULL AND sim!='' AND "+where+";"
+        "DETACH DATABASE previous;"
+        "INSERT INTO campaign VALUES ('reprocessed',"+sqlQuote(reprocessCatalog)+"),('geometry',"+sqlQuote(reprocessGeometry)+");";
+    char* error = NULL;
+    if(sqlite3_exec(catalog,sql.c_str(),NULL,NULL,&error)!=SQLITE_OK){
+        quickSlack("REPROCESS: Could not copy runs from \""+reprocessCatalog+"\": "+string((error!=NULL)?error:"Unknown error"),1);
+        sqlite3_free(error);
+        return 1;
+    }
+
+    // Keep the geometry and parameter values of every run, to report them (see `reportRun`)
+    sqlite3_stmt* statement = NULL;
+    if(sqlite3_prepare_v2(catalog,"SELECT * FROM runs",-1,&statement,NULL)==SQLITE_OK){
+        while(sqlite3_step(statement)==SQLITE_ROW){
+            run r;
+            for(int i=0;i<sqlite3_column_count(statement);i++){
+                string column = sqlite3_column_name(statement,i);
+                const unsigned char* text = sqlite3_column_text(statement,i);
+                if(column=="run_id") r.id = sqlite3_column_int(statement,i);
+                else if(column=="geometry_id") r.geometry = (text!=NULL)?sqlite3_column_int(statement,i):-1;
+                else if(text!=NULL && (column.compare(0,4,"geo_")==0 || column.compare(0,4,"src_")==0)) r.parameters[column] = (const char*)text;
+            }
+            reprocessed[r.id] = r;
+        }
+    }
+    sqlite3_finalize(statement);
+
+    // Queue the runs of each geometry together, so they share its files in the page cache (see `warmGeometry`)
+    vector<pair<string,int>> order;
+    for(auto& run:reprocessRuns) order.push_back(make_pair(run.second.second,run.first));
+    sort(order.begin(),order.end());
+    queueLock.lock();
+    for(auto& run:order){
+        catalogPost("UPDATE runs SET status='queued' WHERE run_id="+to_string(run.second));
+        runQueue.push_back(make_pair(string(""),run.second));
+    }
+    queueLock.unlock();
+    return 0;
+}
+
+
+/**
+ @brief Parse the stages run after revan
+
+ ## Parse the stages run after revan
+
+ ### Arguments
+ - `YAML::Node node` - Stages node to parse settings from
+
+ ### Return value
+ Returns the success value: 0 for success, return code otherwise.
+
+ ### Notes
+ Fills `stages`. Stages may depend on the built in `cosima` and `revan` stages, and on each other, as long as there is no cycle. Per run stages cannot depend on reduce stages.
+*/
+int engine::stagesSetup(YAML::Node node){
+    auto list = [](YAML::Node n){
+        vector<string> values;
+        if(!n) return values;
+        if(n.IsSequence()) for(auto v:n) values.push_back(v.as<string>());
+        else values.push_back(n.as<string>());
+        return values;
+    };
+    for(YAML::const_iterator it=node.begin();it!=node.end();++it){
+        pipelineStage stage;
+        stage.name = it->first.as<string>();
+        if(stage.name=="cosima" || stage.name=="revan" || stage.name=="run"){
+            quickSlack("STAGES SETUP: \""+stage.name+"\" is a reserved stage name. Exiting.",1);
+            return 1;
+        }
+        for(auto& other:stages){
+            if(other.name==stage.name){
+                quickSlack("STAGES SETUP: Stage \""+stage.name+"\" is defined twice. Exiting.",1);
+                return 1;
+            }
+        }
+        if(!it->second["command"]){
+            quickSlack("STAGES SETUP: Stage \""+stage.name+"\" has no command. Exiting.",1);
+            return 1;
+        }
+        stage.command = it->second["command"].as<string>();
+        stage.reduce = it->second["reduce"] && it->second["reduce"].as<bool>();
+        stage.after = it->second["after"]?list(it->second["after"]):vector<string>(1,"revan");
+        stage.inputs = list(it->second["inputs"]);
+        stage.outputs = list(it->second["outputs"]);
+        if(it->second["concurrency"]) stage.concurrency = it->second["concurrency"].as<int>();
+        if(it->second["timeout"]) stage.timeout = it->second["timeout"].as<double>();
+        if(stage.concurrency<1){
+            quickSlack("STAGES SETUP: Stage \""+stage.name+"\" needs a concurrency of at least 1. Exiting.",1);
+            return 1;
+        }
+        stages.push_back(stage);
+    }
+
+    // Resolve dependencies
+    for(auto& stage:stages){
+        for(auto& name:stage.after){
+            if(name=="cosima" || name=="revan") continue;
+            size_t j = 0;
+            while(j<stages.size() && stages[j].name!=name) j++;
+            if(j==stages.size()){
+                quickSlack("STAGES SETUP: Stage \""+stage.name+"\" depends on unknown stage \""+name+"\". Exiting.",1);
+                return 1;
+            }
+            if(!stage.reduce && stages[j].reduce){
+                quickSlack("STAGES SETUP: Per run stage \""+stage.name+"\" cannot depend on reduce stage \""+name+"\". Exiting.",1);
+                return 1;
+            }
+            stage.dependencies.push_back(j);
+        }
+    }
+
+    // Check for cycles
+    vector<int> color(stages.size(),0);
+    function<bool(int)> cyclic = [&](int i){
+        if(color[i]!=0) return color[i]==1;
+        color[i] = 1;
+        for(auto& d:stages[i].dependencies) if(cyclic(d)) return true;
+        color[i] = 2;
+        return false;
+    };
+    for(size_t i=0;i<stages.size();i++){
+        if(cyclic(i)){
+            quickSlack("STAGES SETUP: Stage \""+stages[i].name+"\" depends on itself. Exiting.",1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ @brief Decide whether to keep the .sim.gz files of a run
+
+ ## Decide whether to keep the .sim.gz files of a run, according to `simRetention`
+
+ ### Arguments
+ - `int runNumber` - Run number
+ - `bool failed` - Whether the run failed
+ - `string simFile` - .sim.gz file(s) of the run (for the "pressure" policy)
+
+ ### Notes
+ Policies:
+ - `none` - Never keep them
+ - `all` - Always keep them
+ - `failed` - Only keep them for failed runs
+ - `first` - Keep them for the first `keepFirst` runs to finish of each geometry variant
+ - `pressure` - Keep them until free storage drops below `pressureMB`, then delete the oldest first (see `retentionWatchdog`)
+*/
+bool engine::retainSimulation(int runNumber, bool failed, string simFile){
+    if(simRetention=="all") return 1;
+    if(simRetention=="failed") return failed;
+    lock_guard<mutex> lock(retentionLock);
+    if(simRetention=="first") return keptPerGeometry[runNumber%geometryCount]++<keepFirst;
+    if(simRetention=="pressure"){
+        keptSimulations.push_back(make_pair(runNumber,simFile));
+        return 1;
+    }
+    return 0;
+}
+
+
+/**
+ @brief Retention watchdog program (threadable)
+
+ ## Deletes the oldest kept .sim.gz files while free storage is below `pressureMB`
+
+ ### Notes
+ Only used by the "pressure" retention policy. Sleeps 5 seconds between tests. Deleted files are removed from the catalog.
+*/
+void engine::retentionWatchdog(){
+    struct statvfs buf;
+    while(!exitFlag){
+        if(statvfs(".",&buf)==0){
+            double needed = pressureMB-(double)buf.f_frsize*buf.f_bavail/1000000;
+            retentionLock.lock();
+            while(needed>0 && !keptSimulations.empty()){
+                pair<int,string> oldest = keptSimulations.front();
+                keptSimulations.pop_front();
+                struct stat info;
+                if(stat(oldest.second.c_str(),&info)==0) needed -= (double)info.st_size/1000000;
+                cleanupPost(oldest.second);
+                catalogPost("UPDATE runs SET sim='' WHERE run_id="+to_string(oldest.first));
+            }
+            retentionLock.unlock();
+        }
+        sleep(5);
+    }
+}
+
+
+/**
+ @brief Record the duration of a successful stage
+
+ ## Record the duration of a successful stage
+
+ ### Arguments
+ - `string stage` - Stage name ("cosima", "revan", or "run")
+ - `double seconds` - Duration of the stage
+*/
+void engine::recordDuration(string stage, double seconds){
+    lock_guard<mutex> lock(durationLock);
+    stageDurations[stage].push_back(seconds);
+}
+
+
+/**
+ @brief Percentile of the durations of a stage
+
+ ## Percentile of the durations of a stage
+
+ ### Arguments
+ - `string stage` - Stage name ("cosima", "revan", or "run")
+ - `double percentile` - Percentile to compute (0 to 100)
+ - `int minSamples` - Minimum number of recorded durations
+
+ ### Return value
+ Returns the percentile (nearest rank) in seconds, or -1 if fewer than `minSamples` durations were recorded
+*/
+double engine::stagePercentile(string stage, double percentile, int minSamples){
+    vector<double> durations;
+    durationLock.lock();
+    durations = stageDurations[stage];
+    durationLock.unlock();
+    if(durations.empty() || (int)durations.size()<minSamples) return -1;
+    sort(durations.begin(),durations.end());
+    long rank = (long)ceil(percentile/100*durations.size())-1;
+    return durations[min(max(rank,0L),(long)durations.size()-1)];
+}
+
+
+/**
+ @brief Timeout of a stage
+
+ ## Timeout of a stage
+
+ ### Arguments
+ - `string stage` - Stage name ("cosima" or "revan")
+
+ ### Return value
+ Returns the timeout in seconds, or 0 for no timeout
+
+ ### Notes
+ The timeout is `timeoutFactor` times the `timeoutPercentile` percentile of the durations of the successful stages so far, and at least `timeoutMinimum`. Stages are not timed out until `timeoutSamples` of them succeeded.
+*/
+double engine::stageTimeout(string stage){
+    if(!timeouts) return 0;
+    double percentile = stagePercentile(stage,timeoutPercentile,timeoutSamples);
+    return (percentile<0)?0:max((double)timeoutMinimum,timeoutFactor*percentile);
+}
+
+
+/**
+ @brief Fraction of the configured triggers (or events, or time) a run can be given before the deadline
+
+ ## Fraction of the configured triggers (or events, or time) a run can be given before the deadline
+
+ ### Return value
+ Returns a fraction between `deadlineMinimum` and 1
+
+ ### Notes
+ Compares the thread time left before the deadline with the time every run left would take with the configured triggers: the median of the successful runs so far, scaled to the configured triggers. Runs in progress are assumed to be half done, and runs of unchecked geometries to be valid. Returns 1 until 3 runs succeeded, or if the settings give no triggers (or events, or time) to reduce.
+*/
+double engine::deadlineFraction(){
+    if(!deadlineReduce || sourceTiming[0].empty()) return 1;
+    double full = stagePercentile("full",50,3);
+    if(full<=0) return 1;
+    double left = deadlineTime-time(NULL);
+    if(left<=0) return deadlineMinimum;
+
+    // Count the runs left, including the one asking (already out of the queue, not yet in flight)
+    queueLock.lock();
+    double runs = runQueue.size()+1+max(0,statusBar[2]-statusBar[1])*(double)sourceTemplates.size();
+    queueLock.unlock();
+    inflightLock.lock();
+    runs += 0.5*runsInFlight.size();
+    inflightLock.unlock();
+    return min(1.0,max((double)deadlineMinimum,left*maxThreads/(runs*full)));
+}
+
+
+/**
+ @brief Triggers (or events) a cosima source simulates
+
+ ## Triggers (or events) a cosima source simulates
+
+ ### Arguments
+ - `string source` - Source file
+
+ ### Return value
+ Returns the value of the first `.Triggers` (or `.Events`) keyword of the source, or 0 if it has none
+*/
+long long sourceTarget(string source){
+    ifstream in(source);
+    stringstream contents;
+    contents << in.rdbuf();
+    smatch match;
+    string text = contents.str();
+    if(regex_search(text,match,regex("\\.(Triggers|Events)[ \t]+([0-9]+)"))) return atoll(match[2].str().c_str());
+    return 0;
+}
+
+
+/**
+ @brief Give a run the triggers (or events, or time) it can afford before the deadline
+
+ ## Give a run the triggers (or events, or time) it can afford before the deadline
+
+ ### Arguments
+ - `string source` - Source file of the run
+ - `int runNumber` - Run number
+
+ ### Return value
+ Returns the fraction of the configured triggers (or events, or time) given to the run (see `deadlineFraction`)
+
+ ### Notes
+ Rewrites the source file if the run is reduced, and records the value given in the catalog (`timing_value` and `timing_fraction`). Triggers and events are rounded, to at least 1.
+*/
+double engine::budgetRun(string source, int runNumber){
+    double fraction = deadlineFraction();
+    deadlineLast = fraction;
+    if(fraction>=1) return 1;
+    double full = atof(sourceTiming[1].c_str());
+    string value = (sourceTiming[0]=="Time")?to_string(full*fraction):to_string(max(1LL,llround(full*fraction)));
+
+    ifstream in(source);
+    stringstream contents;
+    contents << in.rdbuf();
+    in.close();
+    regex t("\\..?"+sourceTiming[0]+".*\n");
+    string updated = regex_replace(contents.str(),t,"."+sourceTiming[0]+" "+value+"\n");
+    ofstream out(source);
+    out << updated;
+    out.close();
+    if(!out){
+        quickSlack("DEADLINE: Could not reduce run "+to_string(runNumber)+".",1);
+        return 1;
+    }
+    catalogPost("UPDATE runs SET timing_value="+sqlQuote(value)+",timing_fraction="+to_string(fraction)+" WHERE run_id="+to_string(runNumber));
+    return fraction;
+}
+
+
+/**
+ @brief Combine the results of the stages of a run
+
+ ## Combine the results of the stages of a run
+
+ ### Arguments
+ - `int status` - Return value of `runCommand`
+ - `string stage` - Stage name, for notifications
+ - `int runNumber` - Run number, for notifications
+ - `double timeout` - Timeout the stage ran with, for notifications
+
+ ### Return value
+ Returns 0 on success, `commandTimedOut` or `commandCancelled` if the stage was killed, 1 otherwise
+*/
+int engine::stageResult(int status, string stage, int runNumber, double timeout){
+    if(status==0 || status==commandCancelled) return status;
+    if(status==commandTimedOut){
+        quickSlack("RUN SIMULATION: "+stage+" stage"+((runNumber>=0)?" of run "+to_string(runNumber):string(""))+" timed out after "+beautify_duration(chrono::seconds((long)timeout))+".",1);
+        return status;
+    }
+    return 1;
+}
+
+
+/**
+ @brief Build the shell command to run a MEGAlib program, compressing its output into a log
+
+ ## Build the shell command to run a MEGAlib program
+
+ ### Arguments
+ - `string program` - Program and its arguments
+ - `string log` - Log file to compress the output into
+ - `string dir` - Directory to run the program in
+ - `bool tap` - Whether to copy the output to file descriptor 3 (see `runCommand`), to follow the progress of the program
+
+ ### Notes
+ The command exits with the status of the program, not that of xz. If helper cores are reserved (see `placementSetup`), xz (and tee) are pinned to them.
+*/
+string engine::megalibCommand(string program, string log, string dir, bool tap){
+    string helper = helperCPUs.empty()?string(""):"taskset -c "+helperCPUs+" ";
+    return "bash -c \""+((dir==".")?string(""):"cd "+dir+" && ")+"source ${MEGALIB}/bin/source-megalib.sh; "+program+" |& "+(tap?helper+"tee -p /dev/fd/3 | ":string(""))+helper+"xz -3 > "+log+"; exit \\${PIPESTATUS[0]}\"";
+}
+
+
+/**
+ @brief Build the cosima and revan commands of a run
+
+ ## Build the cosima and revan commands of a run
+
+ ### Arguments
+ - `string source` - Cosima source file
+ - `string geometry` - Geometry file
+ - `int runNumber` - Run number
+ - `uint32_t seed` - Cosima seed
+ - `string dir` - Directory to run in
+ - `string& cosima` - Set to the cosima command
+ - `string& revan` - Set to the revan command
+ - `bool tap` - Whether the commands copy their output to file descriptor 3 (see `megalibCommand`)
+
+ ### Notes
+ When streaming, cosima writes its uncompressed output to the named pipe `run<runNumber>.inc1.id1.sim`.
+*/
+void engine::stageCommands(string source, string geometry, int runNumber, uint32_t seed, string dir, string& cosima, string& revan, bool tap){
+    string run = "run"+to_string(runNumber);
+    bool streaming = stream && simRetention=="none";
+    string simFile = streaming?run+".inc1.id1.sim":run+".*.sim.gz";
+    cosima = megalibCommand("cosima -v "+to_string(cosimaVerbosity)+(streaming?"":" -z")+" -s "+to_string(seed)+" "+((dir==".")?source:absolutePath(source)),"cosima."+run+".log.xz",dir,tap);
+    revan = megalibCommand("revan -c "+revanSettings+" -n -a -f "+simFile+" -g "+geometry,"revan."+run+".log.xz",dir,tap);
+}
+
+
+/**
+ @brief Run cosima and revan at the same time, connected through a named pipe
+
+ ## Run cosima and revan at the same time, connected through a named pipe
+
+ ### Arguments
+ - `string cosimaCommand` - Cosima command, writing uncompressed output to `fifo`
+ - `string revanCommand` - Revan command, reading from `fifo`
+ - `string fifo` - Named pipe to create
+ - `runState& state` - Run to execute: both stages are killed as soon as `state.cancel` is set, and their progress is followed in `state.simulated` and `state.analysed`
+ - `double* setup` - If given, set to the time cosima took to print its first count (see `runCommand`)
+
+ ### Return value
+ Returns 0 if both stages succeeded, `commandCancelled` or `commandTimedOut` if one of them was killed, 1 otherwise
+
+ ### Notes
+ autoMEGA holds both ends of the pipe open until one of the stages exits, so neither side can block forever waiting for the other to open it. If cosima exits first (finished or not) revan sees the end of the file. If revan exits first, cosima gets a broken pipe on its next write (or when it opens the pipe) and fails. The run only succeeds if both stages do.
+*/
+int engine::streamSimulation(string cosimaCommand, string revanCommand, string fifo, runState& state, double* setup){
+    int runNumber = state.run;
+    remove(fifo.c_str());
+    if(mkfifo(fifo.c_str(),0600)){
+        quickSlack("STREAM SIMULATION: Could not create named pipe \""+fifo+"\".",1);
+        return 1;
+    }
+    atomic<int> hold(open(fifo.c_str(),O_RDWR|O_CLOEXEC));
+    if(hold<0){
+        quickSlack("STREAM SIMULATION: Could not open named pipe \""+fifo+"\".",1);
+        remove(fifo.c_str());
+        return 1;
+    }
+
+    // Whichever stage exits first releases the pipe for the other
+    int revanStatus = 0;
+    double cosimaTime = 0, revanTime = 0, cosimaTimeout = stageTimeout("cosima"), revanTimeout = stageTimeout("revan");
+    atomic<bool> cosimaDone(false);
+    thread revan([&](){
+        revanStatus = runCommand(revanCommand,revanTimeout,&state.cancel,&revanTime,&state.analysed,NULL,state.target);
+        int fd = hold.exchange(-1); if(fd>=0) close(fd);
+        // Wake cosima if it is blocked opening the pipe, so it fails instead of waiting forever
+        while(!cosimaDone){
+            fd = open(fifo.c_str(),O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+            if(fd>=0) close(fd);
+            usleep(100000);
+        }
+    });
+    int cosimaStatus = runCommand(cosimaCommand,cosimaTimeout,&state.cancel,&cosimaTime,&state.simulated,setup,state.target);
+    if(cosimaStatus==0) state.simulatedAll = 1;
+    cosimaDone = 1;
+    int fd = hold.exchange(-1); if(fd>=0) close(fd);
+    revan.join();
+
+    remove(fifo.c_str());
+    cosimaStatus = stageResult(cosimaStatus,"cosima",runNumber,cosimaTimeout);
+    revanStatus = stageResult(revanStatus,"revan",runNumber,revanTimeout);
+    if(cosimaStatus==0 && revanStatus==0){
+        recordDuration("cosima",cosimaTime);
+        recordDuration("revan",revanTime);
+        return 0;
+    }
+    if(cosimaStatus==commandCancelled || revanStatus==commandCancelled) return commandCancelled;
+    if(cosimaStatus==commandTimedOut || revanStatus==commandTimedOut) return commandTimedOut;
+    return 1;
+}
+
+
+/**
+ @brief Run the cosima and revan stages of a run
+
+ ## Run the cosima and revan stages of a run
+
+ ### Arguments
+ - `runState& state` - Run to execute, with the seed of the current attempt
+ - `string dir` - Directory to run in
+ - `double* setup` - If given, set to the time the first stage (cosima, or revan when reprocessing) took to print its first count, mostly spent loading the geometry (see `runCommand`)
+
+ ### Return value
+ Returns 0 if both stages succeeded, `commandCancelled` or `commandTimedOut` if one of them was killed, 1 otherwise
+
+ ### Notes
+ Stages are killed if they take longer than `stageTimeout`, or as soon as `state.cancel` is set. The duration of successful stages is recorded for later timeouts.
+
+ When reprocessing, only revan runs, on a link to the kept simulation.
+*/
+int engine::runStages(runState& state, string dir, double* setup){
+    string cosimaCommand, revanCommand;
+    stageCommands(state.source,state.geometry,state.run,state.seed,dir,cosimaCommand,revanCommand,1);
+    double duration = 0, timeout = 0;
+    int status = 0;
+
+    // Reprocessing: revan stage only, on a link to the kept simulation
+    if(!reprocessCatalog.empty()){
+        string link = dir+"/"+state.sim.substr(state.sim.rfind('/')+1);
+        remove(link.c_str());
+        if(symlink(state.sim.c_str(),link.c_str())){
+            quickSlack("RUN SIMULATION: Could not link \""+state.sim+"\" into \""+dir+"\".",1);
+            return 1;
+        }
+        state.simulatedAll = 1;
+        timeout = stageTimeout("revan");
+        status = stageResult(runCommand(revanCommand,timeout,&state.cancel,&duration,&state.analysed,setup),"revan",state.run,timeout);
+        if(!status) recordDuration("revan",duration);
+        return status;
+    }
+    if(stream && simRetention=="none") return streamSimulation(cosimaCommand,revanCommand,dir+"/run"+to_string(state.run)+".inc1.id1.sim",state,setup);
+
+    // Cosima stage
+    timeout = stageTimeout("cosima");
+    status = stageResult(runCommand(cosimaCommand,timeout,&state.cancel,&duration,&state.simulated,setup,state.target),"cosima",state.run,timeout);
+    if(status) return status;
+    recordDuration("cosima",duration);
+    state.simulatedAll = 1;
+    double cosimaTime = duration;
+
+    // Revan stage
+    timeout = stageTimeout("revan");
+    status = stageResult(runCommand(revanCommand,timeout,&state.cancel,&duration,&state.analysed,NULL,state.target),"revan",state.run,timeout);
+    if(status) return status;
+    recordDuration("revan",duration);
+    if(cosimaTime+duration>0) cosimaShare = (cosimaShare*10+cosimaTime/(cosimaTime+duration))/11;
+    return 0;
+}
+
+
+/**
+ @brief Directory a copy of a run executes in
+
+ ## Directory a copy of a run executes in
+
+ ### Arguments
+ - `int runNumber` - Run number
+ - `int copy` - Copy number (0 for the original)
+
+ ### Notes
+ The original runs in `runDirectory(runNumber)`, or in its own directory under `scratch` if that is set. Extra copies always run in their own directory, next to it.
+*/
+string engine::copyDirectory(int runNumber, int copy){
+    string run = "run"+to_string(runNumber);
+    if(copy==0) return scratch.empty()?runDirectory(runNumber):scratchDirectory()+"/"+run;
+    return (scratch.empty()?runDirectory(runNumber):scratchDirectory())+"/"+run+".copy"+to_string(copy);
+}
+
+
+/**
+ @brief Keep the outputs of a copy as the outputs of its run
+
+ ## Keep the outputs of a copy as the outputs of its run
+
+ ### Arguments
+ - `runState& state` - Run the copy belongs to
+ - `string dir` - Directory the copy ran in
+ - `bool failed` - Whether the run failed
+
+ ### Notes
+ Records the size of the .sim.gz and .tra.gz files (for `--plan`), deletes the .sim.gz file unless `retainSimulation` keeps it (in the background, unless it is on scratch), and moves everything left into `runDirectory`.
+*/
+void engine::finishCopy(runState& state, string dir, bool failed){
+    string run = "run"+to_string(state.run);
+    string resultDir = runDirectory(state.run);
+    state.keptSim = 0;
+    struct stat info;
+    string tra = globFirst(dir+"/"+run+".*.tra.gz");
+    state.traBytes = (!tra.empty() && stat(tra.c_str(),&info)==0)?info.st_size:-1;
+    state.simBytes = -1;
+    if(!reprocessCatalog.empty()){
+        // Only a link to the reprocessed simulation, which is never deleted
+        removeWildcard(dir+"/"+run+".*.sim.gz");
+    } else if(!(stream && simRetention=="none")){
+        string sim = globFirst(dir+"/"+run+".*.sim.gz");
+        if(!sim.empty()){
+            if(stat(sim.c_str(),&info)==0) state.simBytes = info.st_size;
+            state.keptSim = retainSimulation(state.run,failed,((resultDir==".")?string(""):resultDir+"/")+sim.substr(dir.size()+1));
+            if(!state.keptSim){
+                if(dir!=resultDir) removeWildcard(dir+"/"+run+".*.sim.gz");
+                else cleanupPost(dir+"/"+run+".*.sim.gz");
+            }
+        }
+    }
+    if(dir!=resultDir){
+        if(makeDirectory(resultDir) || moveDirectory(dir,resultDir)) quickSlack("RUN SIMULATION: Could not move outputs of "+run+" from \""+dir+"\" to \""+resultDir+"\".",1);
+    }
+}
+
+
+/**
+ @brief Remove the outputs of a copy of a run
+
+ ## Remove the outputs of a copy of a run
+
+ ### Arguments
+ - `int runNumber` - Run number
+ - `string dir` - Directory the copy ran in
+
+ ### Notes
+ If the copy ran in `runDirectory`, only its own outputs and logs are removed (not its source file). Otherwise its whole directory is removed.
+*/
+void engine::clearCopy(int runNumber, string dir){
+    string run = "run"+to_string(runNumber);
+    if(dir!=runDirectory(runNumber)){
+        removeWildcard(dir+"/*");
+        rmdir(dir.c_str());
+        return;
+    }
+    for(string pattern:{run+".*.sim*",run+".*.tra*","cosima."+run+".log.xz","revan."+run+".log.xz"}) removeWildcard(dir+"/"+pattern);
+}
+
+
+/**
+ @brief Run one copy of the current attempt of a run
+
+ ## Run one copy of the current attempt of a run
+
+ ### Arguments
+ - `runState& state` - Run to execute
+ - `int copy` - Copy number (0 for the original)
+
+ ### Notes
+ The first copy to succeed wins: it kills the other copies, waits for them to remove their outputs, and keeps its own (see `finishCopy`). If no copy succeeds, the outputs of the last copy to finish are kept, but only on the last attempt. The caller must have counted the copy in `state.running`, which is decremented once the copy is done.
+*/
+void engine::runCopy(runState& state, int copy){
+    string dir = copyDirectory(state.run,copy);
+    auto start = chrono::steady_clock::now();
+    double setup = -1;
+    int status = makeDirectory(dir)?1:runStages(state,dir,&setup);
+    int none = -1;
+    if(status==0 && state.winner.compare_exchange_strong(none,copy)){
+        double duration = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        recordDuration("run",duration);
+        recordDuration("full",duration/state.fraction);
+        if(setup>=0) recordDuration("setup",setup);
+        inflightLock.lock();
+        state.setup = setup;
+        inflightLock.unlock();
+        state.cancel = 1;
+        // Wait for the other copies to be killed and cleaned up
+        while(1){
+            inflightLock.lock();
+            bool alone = state.running==1 && state.cleaning==0;
+            inflightLock.unlock();
+            if(alone) break;
+            usleep(100000);
+        }
+        finishCopy(state,dir,0);
+        lock_guard<mutex> lock(inflightLock);
+        state.running--;
+        return;
+    }
+
+    // Lost or failed: only the last copy of the last attempt keeps its outputs
+    inflightLock.lock();
+    bool keep = state.running==1 && state.winner<0 && state.last;
+    state.running--;
+    if(!keep) state.cleaning++;
+    inflightLock.unlock();
+    if(keep){
+        finishCopy(state,dir,1);
+        return;
+    }
+    clearCopy(state.run,dir);
+    lock_guard<mutex> lock(inflightLock);
+    state.cleaning--;
+}
+
+
+/**
+ @brief Start an extra copy of the slowest straggling run
+
+ ## Start an extra copy of the slowest straggling run
+
+ ### Arguments
+ - `int& copy` - Set to the copy number
+
+ ### Return value
+ Returns the run to copy (already counted in its `running`), or null if no run is straggling
+
+ ### Notes
+ A run is straggling if its current attempt has been running for more than `speculationFactor` times the median duration of successful runs, and it has fewer than `speculationCopies` extra copies.
+*/
+shared_ptr<runState> engine::findStraggler(int& copy){
+    double median = stagePercentile("run",50,speculationSamples);
+    if(median<0) return shared_ptr<runState>();
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(inflightLock);
+    shared_ptr<runState> slowest;
+    for(auto& run:runsInFlight){
+        runState& state = *run.second;
+        if(state.winner>=0 || state.running==0 || state.copies>speculationCopies) continue;
+        if(chrono::duration<double>(now-state.started).count()<speculationFactor*median) continue;
+        if(!slowest || state.started<slowest->started) slowest = run.second;
+    }
+    if(slowest){
+        slowest->running++;
+        copy = slowest->copies++;
+    }
+    return slowest;
+}
+
+
+/**
+ @brief Runs an extra copy of a straggling run (threadable)
+
+ ## Runs an extra copy of a straggling run
+
+ ### Arguments
+ - `shared_ptr<runState> state` - Run to copy, from `findStraggler`
+ - `int copy` - Copy number, from `findStraggler`
+*/
+void engine::speculateRun(shared_ptr<runState> state, int copy){
+    int slot = placementAcquire();
+    runCopy(*state,copy);
+    placementRelease(slot);
+    currentThreadCount--;
+}
+
+
+/**
+ @brief Quote a string for use as a single shell word
+
+ ## Quote a string for use as a single shell word
+*/
+string shellQuote(string value){
+    string quoted = "'";
+    for(auto& c:value){
+        if(c=='\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted+"'";
+}
+
+
+/**
+ @brief Fill the placeholders of a stage template
+
+ ## Fill the placeholders of a stage template
+
+ ### Arguments
+ - `string text` - Template, with placeholders in braces (eg. `{tra}`)
+ - `const map<string,string>& values` - Value of every placeholder
+ - `bool quote` - Whether to quote every value as a single shell word (see `shellQuote`), for commands
+
+ ### Notes
+ Unknown placeholders are left as they are. Every run has `{run}` (eg. `run12`), `{runNumber}`, `{dir}` (its directory), `{source}`, `{geometry}`, `{sim}` (empty unless it was kept), `{tra}` and `{seed}`. Every stage, including reduce stages, has `{campaign}` (the campaign directory) and `{catalog}`. Paths are absolute.
+*/
+string stageExpand(string text, const map<string,string>& values, bool quote=false){
+    string expanded;
+    for(size_t i=0;i<text.size();i++){
+        size_t end = (text[i]=='{')?text.find('}',i):string::npos;
+        auto value = (end!=string::npos)?values.find(text.substr(i+1,end-i-1)):values.end();
+        if(value==values.end()){
+            expanded += text[i];
+            continue;
+        }
+        expanded += quote?shellQuote(value->second):value->second;
+        i = end;
+    }
+    return expanded;
+}
+
+
+/**
+ @brief Placeholder values shared by every stage
+
+ ## Placeholder values shared by every stage
+*/
+map<string,string> campaignValues(){
+    map<string,string> values;
+    char pwd[PATH_MAX];
+    values["campaign"] = (getcwd(pwd,sizeof(pwd))!=NULL)?pwd:".";
+    values["catalog"] = values["campaign"]+"/catalog.db";
+    return values;
+}
+
+
+/**
+ @brief Queue the per run stages of a run whose dependencies all succeeded
+
+ ## Queue the per run stages of a run whose dependencies all succeeded
+
+ ### Arguments
+ - `int runNumber` - Run number
+
+ ### Notes
+ Must be called with `stageLock` held, and the run in `stageRuns`.
+*/
+void engine::stageRelease(int runNumber){
+    stageProgress& progress = stageRuns[runNumber];
+    for(size_t i=0;i<stages.size();i++){
+        if(stages[i].reduce || progress.status[i]!=0) continue;
+        bool ready = 1;
+        for(auto& d:stages[i].dependencies) if(progress.status[d]!=2) ready = 0;
+        if(!ready) continue;
+        progress.status[i] = 1;
+        progress.active++;
+        stages[i].queue.push_back(runNumber);
+    }
+}
+
+
+/**
+ @brief Queue the stages following revan for a successful run
+
+ ## Queue the stages following revan for a successful run
+
+ ### Arguments
+ - `int runNumber` - Run number
+ - `map<string,string> values` - Placeholder values of the run (see `stageExpand`)
+*/
+void engine::stageRunDone(int runNumber, map<string,string> values){
+    lock_guard<mutex> lock(stageLock);
+    stageProgress& progress = stageRuns[runNumber];
+    progress.values = values;
+    progress.status.assign(stages.size(),0);
+    stageRelease(runNumber);
+    if(progress.active==0) stageRuns.erase(runNumber);
+}
+
+
+/**
+ @brief Take the next per run stage job to start
+
+ ## Take the next per run stage job to start
+
+ ### Arguments
+ - `int& runNumber` - Set to the run number of the job
+
+ ### Return value
+ Returns the index of the stage, or -1 if no job can start
+
+ ### Notes
+ Later stages go first, so the results of the runs that are furthest along are finished first. Stages running `concurrency` jobs are skipped.
+*/
+int engine::nextStageJob(int& runNumber){
+    lock_guard<mutex> lock(stageLock);
+    for(int i=stages.size()-1;i>=0;i--){
+        pipelineStage& stage = stages[i];
+        if(stage.reduce || stage.queue.empty() || stage.running>=stage.concurrency) continue;
+        runNumber = stage.queue.front();
+        stage.queue.pop_front();
+        stage.running++;
+        return i;
+    }
+    return -1;
+}
+
+
+/**
+ @brief Take the next reduce stage to start
+
+ ## Take the next reduce stage to start
+
+ ### Return value
+ Returns the index of the stage, or -1 if no reduce stage can start
+
+ ### Notes
+ Reduce stages only start once every run and every per run stage is done, and once the reduce stages they depend on succeeded. If one of those failed, or a per run stage they depend on (directly or through other per run stages) failed for any run, the stage is skipped rather than run on partial results.
+*/
+int engine::nextReduceStage(){
+    if(!geometryDone || currentThreadCount-stageJobsRunning>0) return -1;
+    queueLock.lock();
+    bool waiting = !checkQueue.empty() || !runQueue.empty();
+    queueLock.unlock();
+    if(waiting) return -1;
+
+    lock_guard<mutex> lock(stageLock);
+    for(auto& stage:stages) if(!stage.reduce && (stage.running>0 || !stage.queue.empty())) return -1;
+    for(size_t i=0;i<stages.size();i++){
+        pipelineStage& stage = stages[i];
+        if(!stage.reduce || stage.state!=0) continue;
+        bool ready = 1;
+        string failed;
+        vector<int> upstream = stage.dependencies;
+        for(size_t j=0;j<upstream.size();j++){
+            pipelineStage& other = stages[upstream[j]];
+            if(other.reduce){
+                if(other.state<2) ready = 0;
+                if(other.state==3 && failed.empty()) failed = "reduce stage \""+other.name+"\" failed";
+                continue;
+            }
+            if(other.failed>0 && failed.empty()) failed = "stage \""+other.name+"\" failed for "+to_string(other.failed)+" run"+((other.failed>1)?"s":"");
+            for(auto& d:other.dependencies) if(find(upstream.begin(),upstream.end(),d)==upstream.end()) upstream.push_back(d);
+        }
+        if(!failed.empty()){
+            stage.state = 3;
+            catalogPost("INSERT INTO stages(run_id,stage,status) VALUES (NULL,"+sqlQuote(stage.name)+",'skipped')");
+            quickSlack("STAGE "+stage.name+": Skipped, since "+failed+".",1);
+            continue;
+        }
+        if(!ready) continue;
+        stage.state = 1;
+        stage.running++;
+        return i;
+    }
+    return -1;
+}
+
+
+/**
+ @brief Whether every stage job is done
+
+ ## Whether every stage job is done
+*/
+bool engine::stagesIdle(){
+    lock_guard<mutex> lock(stageLock);
+    for(auto& stage:stages) if(stage.running>0 || !stage.queue.empty() || (stage.reduce && stage.state<2)) return 0;
+    return 1;
+}
+
+
+/**
+ @brief Runs one job of a stage (threadable)
+
+ ## Runs one job of a stage
+
+ ### Arguments
+ - `int stageIndex` - Index of the stage in `stages`
+ - `int runNumber` - Run number, or -1 for a reduce stage
+
+ ### Notes
+ Runs the command in the directory of the run (the campaign directory for reduce stages), with the MEGAlib environment, compressing its output into `<stage>.run<N>.log.xz` (`<stage>.log.xz`). The job fails if an input is missing before it starts, if the command fails, or if an output is missing once it is done. Every job is recorded in the `stages` table of the catalog. Once a per run job succeeded, the stages depending on it are queued.
+*/
+void engine::runStage(int stageIndex, int runNumber){
+    long started = time(NULL);
+    stageLock.lock();
+    pipelineStage stage = stages[stageIndex];
+    map<string,string> values = (runNumber>=0)?stageRuns[runNumber].values:campaignValues();
+    stageLock.unlock();
+    string dir = (runNumber>=0)?runDirectory(runNumber):".";
+    string prefix = (dir==".")?string(""):dir+"/";
+    string log = stage.name+"."+((runNumber>=0)?"run"+to_string(runNumber)+".":string(""))+"log.xz";
+
+    // The command ends up in double quotes (see megalibCommand), so nothing is expanded before bash runs it, and may be a list of commands
+    string program = "(";
+    for(auto& c:stageExpand(stage.command,values,1)){
+        if(c=='"' || c=='\\' || c=='$' || c=='`') program += '\\';
+        program += c;
+    }
+    program += ")";
+    string command = megalibCommand(program,log,dir);
+    string outputs;
+    for(auto& output:stage.outputs) outputs += (outputs.empty()?"":",")+stageExpand(output,values);
+
+    bool failed = 0;
+    if(test) cout << command << endl;
+    else {
+        for(auto& input:stage.inputs){
+            string file = stageExpand(input,values);
+            if(!fileExists((file[0]=='/')?file:prefix+file)){
+                quickSlack("STAGE "+stage.name+": Missing input \""+file+"\""+((runNumber>=0)?" for run "+to_string(runNumber):string(""))+".",1);
+                failed = 1;
+            }
+        }
+        if(!failed){
+            int slot = placementAcquire();
+            failed = stageResult(runCommand(command,stage.timeout),stage.name,runNumber,stage.timeout)!=0;
+            placementRelease(slot);
+        }
+        for(size_t i=0;i<stage.outputs.size() && !failed;i++){
+            string file = stageExpand(stage.outputs[i],values);
+            if(!fileExists((file[0]=='/')?file:prefix+file)){
+                quickSlack("STAGE "+stage.name+": Missing output \""+file+"\""+((runNumber>=0)?" for run "+to_string(runNumber):string(""))+".",1);
+                failed = 1;
+            }
+        }
+    }
+    catalogPost("INSERT INTO stages(run_id,stage,status,started,finished,log,outputs) VALUES ("+((runNumber>=0)?to_string(runNumber):string("NULL"))+","+sqlQuote(stage.name)+","+(failed?"'failed'":"'done'")+","+to_string(started)+","+to_string(time(NULL))+","+sqlQuote(prefix+log)+","+sqlQuote(outputs)+")");
+    if(failed) quickSlack("Stage "+stage.name+((runNumber>=0)?" of run "+to_string(runNumber):string(""))+" failed.",2);
+
+    stageLock.lock();
+    stages[stageIndex].running--;
+    if(failed) stages[stageIndex].failed++;
+    else stages[stageIndex].done++;
+    if(runNumber>=0){
+        stageProgress& progress = stageRuns[runNumber];
+        progress.status[stageIndex] = failed?3:2;
+        progress.active--;
+        if(!failed) stageRelease(runNumber);
+        if(progress.active==0) stageRuns.erase(runNumber);
+    } else stages[stageIndex].state = failed?3:2;
+    stageLock.unlock();
+
+    stageJobsRunning--;
+    currentThreadCount--;
+}
+
+
+/**
+ @brief Bin of the energy spectrum of the summary an energy falls in
+
+ ## Bin of the energy spectrum of the summary an energy falls in
+
+ ### Arguments
+ - `double energy` - Energy, in keV
+
+ ### Return value
+ Returns the index in `traSummary::spectrum`: 0 for the underflow, `summaryBins+1` for the overflow
+*/
+int engine::summaryBin(double energy){
+    double minimum = summaryMinimum, maximum = summaryMaximum;
+    if(summaryLogarithmic){
+        if(energy<=0 || minimum<=0) return 0;
+        energy = log(energy); minimum = log(minimum); maximum = log(maximum);
+    }
+    if(energy<minimum) return 0;
+    if(energy>=maximum) return summaryBins+1;
+    return 1+min((int)((energy-minimum)/(maximum-minimum)*summaryBins),summaryBins-1);
+}
+
+
+/**
+ @brief Lower edge of a bin of the energy spectrum of the summary
+
+ ## Lower edge of a bin of the energy spectrum of the summary
+
+ ### Arguments
+ - `int bin` - Bin, from 0 (first bin, not the underflow) to `summaryBins`
+*/
+double engine::summaryEdge(int bin){
+    if(summaryLogarithmic) return summaryMinimum*pow(summaryMaximum/summaryMinimum,(double)bin/summaryBins);
+    return summaryMinimum+(summaryMaximum-summaryMinimum)*bin/summaryBins;
+}
+
+
+/**
+ @brief Add the events of a .tra.gz file to a summary
+
+ ## Add the events of a .tra.gz file to a summary
+
+ ### Arguments
+ - `string filename` - .tra.gz file to scan
+ - `traSummary& summary` - Summary to add the events to
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ The file is inflated in its own thread, one block at a time, while this thread parses the blocks already inflated. Only the first two characters of every line are looked at, except on the lines the summary uses. See `traSummary`.
+*/
+bool engine::traScan(string filename, traSummary& summary){
+    gzFile file = gzopen(filename.c_str(),"rb");
+    if(file==NULL) return 1;
+    gzbuffer(file,1<<20);
+    if(summary.spectrum.size()!=(size_t)summaryBins+2) summary.spectrum.assign(summaryBins+2,0);
+
+    // Inflate blocks ahead of the parser, at most 4 of them
+    deque<string> blocks;
+    mutex blockLock;
+    condition_variable blockReady;
+    bool inflated = 0, failed = 0;
+    thread inflater([&](){
+        while(1){
+            string block(1<<20,'\0');
+            int length = gzread(file,&block[0],block.size());
+            if(length<=0){
+                if(length<0) failed = 1;
+                break;
+            }
+            block.resize(length);
+            unique_lock<mutex> lock(blockLock);
+            blockReady.wait(lock,[&](){ return blocks.size()<4; });
+            blocks.push_back(move(block));
+            blockReady.notify_all();
+        }
+        lock_guard<mutex> lock(blockLock);
+        inflated = 1;
+        blockReady.notify_all();
+    });
+
+    // Parse every line, and add each event once the next one starts
+    string type;
+    double energy = 0;
+    bool inEvent = 0;
+    auto endEvent = [&](){
+        if(!inEvent) return;
+        summary.events++;
+        summary.types[type.empty()?string("none"):type]++;
+        if(type=="CO" || type=="PH" || type=="PA") summary.spectrum[summaryBin(energy)]++;
+    };
+    auto parse = [&](const char* line, size_t length){
+        if(length<2) return;
+        if(line[0]=='S' && line[1]=='E'){
+            endEvent();
+            inEvent = 1;
+            type.clear();
+            energy = 0;
+            return;
+        }
+        if(!inEvent || (length>2 && !isspace((unsigned char)line[2]))) return;
+        string key(line,2);
+        if(key!="ET" && key!="BD" && key!="CE" && key!="PE" && key!="PP") return;
+        string rest(line+2,length-2);
+        if(key=="ET"){
+            stringstream ss(rest);
+            ss >> type;
+        } else if(key=="BD"){
+            stringstream ss(rest);
+            string flag; ss >> flag;
+            summary.flags[flag.empty()?string("none"):flag]++;
+        } else if(key=="CE"){
+            double gamma = 0, gammaError = 0, electron = 0;
+            stringstream(rest) >> gamma >> gammaError >> electron;
+            energy = gamma+electron;
+        } else {
+            double value = 0;
+            stringstream(rest) >> value;
+            energy += value;
+        }
+    };
+    string partial;
+    while(1){
+        string block;
+        {
+            unique_lock<mutex> lock(blockLock);
+            blockReady.wait(lock,[&](){ return !blocks.empty() || inflated; });
+            if(blocks.empty()) break;
+            block = move(blocks.front());
+            blocks.pop_front();
+            blockReady.notify_all();
+        }
+        size_t begin = 0;
+        for(size_t end;(end=block.find('\n',begin))!=string::npos;begin=end+1){
+            if(partial.empty()) parse(block.data()+begin,end-begin);
+            else {
+                partial.append(block,begin,end-begin);
+                parse(partial.data(),partial.size());
+                partial.clear();
+            }
+        }
+        partial.append(block,begin,string::npos);
+    }
+    if(!partial.empty()) parse(partial.data(),partial.size());
+    endEvent();
+    inflater.join();
+    return gzclose(file)!=Z_OK || failed;
+}
+
+
+/**
+ @brief Summarise the revan output of a run
+
+ ## Summarise the revan output of a run
+
+ ### Arguments
+ - `int runNumber` - Run number
+ - `string prefix` - Path of the outputs of the run, up to (and including) `run<N>`
+
+ ### Notes
+ Every .tra.gz file of the run is scanned (see `traScan`). The summary is recorded in the `summaries` table of the catalog right away, so it survives a crash or a drain, and `summaryWrite` builds the summary file from that table. Counters are stored as `<name>=<count>` separated by spaces (eg. `CO=1200 PH=300`), and the spectrum as the counts of its bins (underflow first, overflow last) separated by spaces.
+*/
+void engine::summariseRun(int runNumber, string prefix){
+    glob_t files;
+    traSummary summary;
+    summary.spectrum.assign(summaryBins+2,0);
+    if(glob((prefix+".*.tra.gz").c_str(),0,NULL,&files)==0){
+        for(size_t i=0;i<files.gl_pathc;i++) if(traScan(files.gl_pathv[i],summary)) quickSlack("SUMMARY: Could not read \""+string(files.gl_pathv[i])+"\".",1);
+    }
+    globfree(&files);
+    string types, flags, spectrum;
+    for(auto& t:summary.types) types += (types.empty()?"":" ")+t.first+"="+to_string(t.second);
+    for(auto& f:summary.flags) flags += (flags.empty()?"":" ")+f.first+"="+to_string(f.second);
+    for(auto& bin:summary.spectrum) spectrum += (spectrum.empty()?"":" ")+to_string(bin);
+    catalogPost("INSERT OR REPLACE INTO summaries VALUES ("+to_string(runNumber)+","+to_string(summary.events)+","+sqlQuote(types)+","+sqlQuote(flags)+","+sqlQuote(spectrum)+")");
+}
+
+
+/**
+ @brief Write the summaries of every successful run
+
+ ## Write the summaries of every successful run
+
+ ### Arguments
+ - `string filename` - File to write
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Reads the catalog directly (the `summaries` table, see `summariseRun`, and the `runs` table), so it must be called once the catalog writer is done. The parameters of reprocessed runs are those copied from the previous catalog.
+
+ Tab separated, with a header and one line per run, in run order. The columns are the run and geometry numbers and the parameter columns (`geo_*` and `src_*`) of the `runs` table of the catalog, the number of events, the number of events of every type (`type_<ET>`) and bad event flag (`bad_<BD>`) seen in the campaign, and the energy spectrum (`keV_under`, `keV_<lower edge>` for every bin, and `keV_over`).
+*/
+bool engine::summaryWrite(string filename){
+    // Parameter columns of the runs table
+    string columns, select = "SELECT summaries.run_id,runs.geometry_id";
+    sqlite3_stmt* statement = NULL;
+    if(sqlite3_prepare_v2(catalog,"PRAGMA table_info(runs)",-1,&statement,NULL)==SQLITE_OK){
+        while(sqlite3_step(statement)==SQLITE_ROW){
+            string column = (const char*)sqlite3_column_text(statement,1);
+            if(column.compare(0,4,"geo_")!=0 && column.compare(0,4,"src_")!=0) continue;
+            columns += "\t"+column;
+            select += ",runs.\""+column+"\"";
+        }
+    }
+    sqlite3_finalize(statement);
+
+    // Summary of every run, with its geometry number and parameter values
+    vector<pair<string,traSummary>> rows;
+    set<string> types, flags;
+    auto counters = [](string text, map<string,long long>& counts, set<string>& names){
+        stringstream ss(text);
+        for(string counter;ss >> counter;){
+            size_t separator = counter.rfind('=');
+            if(separator==string::npos) continue;
+            counts[counter.substr(0,separator)] = atoll(counter.c_str()+separator+1);
+            names.insert(counter.substr(0,separator));
+        }
+    };
+    select += ",summaries.events,summaries.types,summaries.flags,summaries.spectrum FROM summaries LEFT JOIN runs ON runs.run_id=summaries.run_id ORDER BY summaries.run_id";
+    if(sqlite3_prepare_v2(catalog,select.c_str(),-1,&statement,NULL)!=SQLITE_OK){
+        sqlite3_finalize(statement);
+        return 1;
+    }
+    int values = sqlite3_column_count(statement)-4;
+    while(sqlite3_step(statement)==SQLITE_ROW){
+        auto text = [&](int i){ const unsigned char* value = sqlite3_column_text(statement,i); return (value==NULL)?string(""):string((const char*)value); };
+        string description = text(0);
+        for(int i=1;i<values;i++) description += "\t"+text(i);
+        traSummary summary;
+        summary.events = sqlite3_column_int64(statement,values);
+        counters(text(values+1),summary.types,types);
+        counters(text(values+2),summary.flags,flags);
+        stringstream spectrum(text(values+3));
+        for(long long bin;spectrum >> bin;) summary.spectrum.push_back(bin);
+        summary.spectrum.resize(summaryBins+2,0);
+        rows.push_back(make_pair(description,summary));
+    }
+    sqlite3_finalize(statement);
+
+    ofstream out(filename);
+    if(!out.is_open()) return 1;
+    out << "run_id\tgeometry_id" << columns << "\tevents";
+    for(auto& t:types) out << "\ttype_" << t;
+    for(auto& f:flags) out << "\tbad_" << f;
+    out << "\tkeV_under";
+    for(int i=0;i<summaryBins;i++) out << "\tkeV_" << summaryEdge(i);
+    out << "\tkeV_over\n";
+    for(auto& row:rows){
+        traSummary& summary = row.second;
+        out << row.first << "\t" << summary.events;
+        for(auto& t:types) out << "\t" << summary.types[t];
+        for(auto& f:flags) out << "\t" << summary.flags[f];
+        for(auto& bin:summary.spectrum) out << "\t" << bin;
+        out << "\n";
+    }
+    out.close();
+    return !out;
+}
+
+
+/**
+ @brief Geometry file of a queued run
+
+ ## Geometry file of a queued run
+
+ ### Arguments
+ - `int runNumber` - Run number
+
+ ### Return value
+ Returns the absolute path of the geometry setup file of the run, or an empty string if it is not known (eg. the geometry of the base source file)
+
+ ### Notes
+ Must be called with `queueLock` held.
+*/
+string engine::runGeometry(int runNumber){
+    if(!reprocessCatalog.empty()){
+        auto run = reprocessRuns.find(runNumber);
+        return (run==reprocessRuns.end())?string(""):absolutePath(run->second.second);
+    }
+    auto geometry = geometryFiles.find((geometryCount>0)?runNumber%geometryCount:0);
+    return (geometry==geometryFiles.end())?string(""):geometry->second;
+}
+
+
+/**
+ @brief Read the files of a geometry into the page cache
+
+ ## Read the files of a geometry into the page cache
+
+ ### Arguments
+ - `string geometry` - Geometry setup file (absolute path)
+
+ ### Notes
+ The first time, the setup file and every file it includes are read (see `geoRead`), which loads them into the page cache, and remembered in `warmFiles`. Afterwards the kernel is only asked to read them ahead (`POSIX_FADV_WILLNEED`), which costs nothing for pages still cached. Cosima and revan then load the geometry from memory, instead of competing for the disk with the runs of other variants.
+*/
+void engine::warmGeometry(string geometry){
+    if(geometry.empty()) return;
+    warmLock.lock();
+    auto known = warmFiles.find(geometry);
+    vector<string> files;
+    bool found = known!=warmFiles.end();
+    if(found) files = known->second;
+    warmLock.unlock();
+    if(found){
+        for(auto& file:files){
+            int fd = open(file.c_str(),O_RDONLY|O_CLOEXEC);
+            if(fd<0) continue;
+            posix_fadvise(fd,0,0,POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+        return;
+    }
+
+    set<string> seen;
+    deque<string> pending(1,geometry);
+    while(!pending.empty()){
+        string path = pending.front(); pending.pop_front();
+        if(!seen.insert(path).second) continue;
+        string text;
+        if(geoRead(path,text)) continue;
+        files.push_back(path);
+        string reference;
+        for(size_t begin=0;begin<text.size();begin=text.find('\n',begin)+1) if(geoInclude(text,begin,reference)) pending.push_back(resolveInclude(path,reference));
+    }
+    lock_guard<mutex> lock(warmLock);
+    warmFiles[geometry] = files;
+}
+
+
+/**
+ @brief Runs the Cosima simulation and Revan data reduction for one set of parameters
+
+ ##  Runs the Cosima simulation and Revan data reduction for one set of parameters
+
+ ### Arguments
+ - `const string source` - *.source file for cosima
+ - `const int threadNumber` - Thread number to avoid file name collisions
+
+ ### Notes
+ Often runs out of storage if you are not careful
+
+ Runs in `runDirectory(threadNumber)`, or in its own directory under `scratch` if that is set. In the latter case everything left once the run is done (outputs and logs, but not deleted intermediary files) is moved to `runDirectory(threadNumber)`.
+
+ With placement enabled, both stages are pinned to a core set while they run (see `placementAcquire`).
+
+ A failed (or timed out) run is retried up to `retries` times, each attempt with its own seed (`deriveSeed(threadNumber,attempt)`). Extra copies of an attempt may be started by the dispatcher (see `findStraggler`), in which case the first copy to succeed wins.
+*/
+void engine::runSimulation(const string source, const int threadNumber){
+    // Setup
+    auto start = chrono::steady_clock::now();
+
+    // Record run in catalog
+    catalogPost("UPDATE runs SET status='running',started="+to_string(time(NULL))+",directory="+sqlQuote(runDirectory(threadNumber))+" WHERE run_id="+to_string(threadNumber));
+
+    // Get geometry file
+    string geoSetup, sim;
+    if(!reprocessCatalog.empty()){
+        auto reprocessed = reprocessRuns.find(threadNumber);
+        if(reprocessed==reprocessRuns.end()){ quickSlack("RUN SIMULATION"+to_string(threadNumber)+": Not a reprocessed run.",1); currentThreadCount--; return; }
+        sim = reprocessed->second.first;
+        geoSetup = reprocessed->second.second;
+    } else {
+        ifstream sourceFile(source);
+        while(!sourceFile.eof() && geoSetup!="Geometry") sourceFile>>geoSetup;
+        if(geoSetup!="Geometry"){cerr << "Cannot locate geometry file. Exiting." << endl; if(slackVerbosity>=1) quickSlack("RUN SIMULATION"+to_string(threadNumber)+": Cannot locate geometry file."); currentThreadCount--; return;}
+        sourceFile>>geoSetup;
+        sourceFile.close();
+    }
+
+    // Actually run simulation and analysis, and remove intermediary files when they are no longer necessary (according to simRetention)
+    string run = "run"+to_string(threadNumber);
+    string resultDir = runDirectory(threadNumber);
+    uint32_t seed = deriveSeed(threadNumber);
+    bool keptSim = 0;
+    if(!test){
+        shared_ptr<runState> state(new runState());
+        if(deadlineTime>0 && reprocessCatalog.empty()) state->fraction = budgetRun(source,threadNumber);
+        state->source = source;
+        state->geometry = geoSetup;
+        state->sim = sim;
+        state->run = threadNumber;
+        if(reprocessCatalog.empty()) state->target = sourceTarget(source);
+        double started = 0;
+        runsStarted.compare_exchange_strong(started,chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count());
+        inflightLock.lock();
+        runsInFlight[threadNumber] = state;
+        inflightLock.unlock();
+
+        // Warm the geometry of the run, and the next variant in the queue, so it is cached by the time its runs start
+        if(warmGeometries){
+            string geometry = absolutePath(geoSetup), next;
+            warmGeometry(geometry);
+            queueLock.lock();
+            for(auto& queued:runQueue) if((next = runGeometry(queued.second))!=geometry) break;
+            queueLock.unlock();
+            if(next!=geometry) warmGeometry(next);
+        }
+
+        int slot = placementAcquire();
+        int attempt = 0;
+        for(;;attempt++){
+            // Every attempt gets its own seed, shared by all of its copies
+            inflightLock.lock();
+            state->seed = deriveSeed(threadNumber,attempt);
+            state->winner = -1;
+            state->cancel = 0;
+            state->last = attempt>=retries;
+            state->running = state->copies = 1;
+            state->started = chrono::steady_clock::now();
+            eventsFinished += state->simulated.exchange(0);
+            state->analysed = 0;
+            state->simulatedAll = 0;
+            inflightLock.unlock();
+            // The seed of a reprocessed run is the one its simulation was made with
+            catalogPost("UPDATE runs SET "+(reprocessCatalog.empty()?"seed="+to_string(state->seed)+",":string(""))+"attempts="+to_string(attempt+1)+" WHERE run_id="+to_string(threadNumber));
+
+            runCopy(*state,0);
+
+            // Wait for the extra copies, if any
+            while(1){
+                inflightLock.lock();
+                bool done = state->running==0 && state->cleaning==0;
+                inflightLock.unlock();
+                if(done) break;
+                usleep(100000);
+            }
+            if(state->winner>=0 || state->last || interrupted) break;
+            quickSlack("Run "+to_string(threadNumber)+" failed. Retrying with a new seed ("+to_string(attempt+1)+"/"+to_string(retries)+").",2);
+        }
+        placementRelease(slot);
+        inflightLock.lock();
+        runsInFlight.erase(threadNumber);
+        eventsFinished += state->simulated.exchange(0);
+        inflightLock.unlock();
+
+        bool failed = state->winner<0;
+        seed = state->seed;
+        keptSim = state->keptSim;
+        if(!failed){
+            statusBar[4]++;
+            statusBar[7]++;
+        }
+        string prefix = (resultDir==".")?string(""):resultDir+"/";
+        string tra = globFirst(prefix+run+".*.tra*");
+        catalogPost("UPDATE runs SET status="+string(failed?"'failed'":"'done'")+",finished="+to_string(time(NULL))
+            +",sim="+sqlQuote(!reprocessCatalog.empty()?sim:(state->keptSim?globFirst(prefix+run+".*.sim.gz"):""))+",tra="+sqlQuote(tra)
+            +",cosima_log="+sqlQuote(globFirst(prefix+"cosima."+run+".log.xz"))+",revan_log="+sqlQuote(globFirst(prefix+"revan."+run+".log.xz"))
+            +",sim_bytes="+((state->simBytes<0)?string("NULL"):to_string(state->simBytes))+",tra_bytes="+((state->traBytes<0)?string("NULL"):to_string(state->traBytes))
+            +",setup="+((state->setup<0)?string("NULL"):to_string(state->setup))
+            +" WHERE run_id="+to_string(threadNumber));
+        reportRun(threadNumber,failed,attempt+1,tra);
+        if(failed){
+            quickSlack("Run "+to_string(threadNumber)+" failed"+((attempt>0)?" after "+to_string(attempt+1)+" attempts.":"."));
+            currentThreadCount--;
+            return;
+        }
+
+        // Summarise the revan output while it is still in the page cache
+        if(summarise) summariseRun(threadNumber,prefix+run);
+    }else{
+        // Dry run
+        string workDir = copyDirectory(threadNumber,0);
+        bool streaming = stream && simRetention=="none";
+        string simFile = streaming?run+".inc1.id1.sim":run+".*.sim.gz";
+        string cosimaCommand, revanCommand;
+        stageCommands(source,geoSetup,threadNumber,seed,workDir,cosimaCommand,revanCommand,0);
+        if(workDir!=".") cout << "mkdir -p "+workDir+"\n";
+        if(!reprocessCatalog.empty()) cout << "ln -s "+sim+" "+workDir+"/\n" << revanCommand << "\nrm "+workDir+"/"+simFile+"\n";
+        else if(streaming) cout << "mkfifo "+workDir+"/"+simFile+"\n(" << cosimaCommand << ") & " << revanCommand << "\nrm "+workDir+"/"+simFile+"\n";
+        else {
+            cout << cosimaCommand << "\n" << revanCommand << "\n";
+            if(simRetention=="none") cout << "rm "+workDir+"/"+simFile+"\n";
+        }
+        if(workDir!=resultDir) cout << "mkdir -p "+resultDir+"\nmv "+workDir+"/* "+resultDir+"/\nrmdir "+workDir+"\n";
+    }
+
+    // Queue the stages following revan
+    if(!stages.empty()){
+        string prefix = (resultDir==".")?string(""):resultDir+"/";
+        map<string,string> values = campaignValues();
+        values["run"] = run;
+        values["runNumber"] = to_string(threadNumber);
+        values["dir"] = (resultDir==".")?values["campaign"]:absolutePath(resultDir);
+        values["source"] = source.empty()?string(""):absolutePath(source);
+        values["geometry"] = absolutePath(geoSetup);
+        values["sim"] = !sim.empty()?sim:(keptSim?absolutePath(globFirst(prefix+run+".*.sim.gz")):string(""));
+        values["tra"] = test?absolutePath(prefix+run+".inc1.id1.tra.gz"):absolutePath(globFirst(prefix+run+".*.tra.gz"));
+        values["seed"] = to_string(seed);
+        stageRunDone(threadNumber,values);
+    }
+
+    // End timer, calculate new average time
+    auto end = chrono::steady_clock::now();
+    chrono::seconds thisTime = chrono::duration_cast<chrono::seconds>(end-start);
+    timeLock.lock();
+    averageTime = (averageTime.count()!=0)?(averageTime*10+thisTime)/(11):thisTime;
+    timeLock.unlock();
+
+    // Cleanup and exit
+    currentThreadCount--;
+    return;
+}
+
+
+/**
+ @brief Quote a string for JSON
+
+ ## Quote a string for JSON
+*/
+string jsonQuote(string value){
+    string quoted = "\"";
+    for(auto& c:value){
+        if(c=='"' || c=='\\') quoted += '\\';
+        if((unsigned char)c<0x20){
+            char escaped[8];
+            snprintf(escaped,sizeof(escaped),"\\u%04x",c);
+            quoted += escaped;
+        } else quoted += c;
+    }
+    return quoted+"\"";
+}
+
+
+/**
+ @brief Move queued jobs to the front of their queue
+
+ ## Move queued jobs to the front of their queue
+
+ ### Arguments
+ - `deque<pair<string,int>>& queue` - Queue to reorder
+ - `function<bool(int)> selected` - Whether a job (by number) is moved
+
+ ### Return value
+ Returns the number of jobs moved
+
+ ### Notes
+ Must be called with `queueLock` held. Moved jobs keep their relative order.
+*/
+int queueFront(deque<pair<string,int>>& queue, function<bool(int)> selected){
+    deque<pair<string,int>> front, back;
+    for(auto& job:queue) (selected(job.second)?front:back).push_back(job);
+    int moved = front.size();
+    front.insert(front.end(),back.begin(),back.end());
+    queue.swap(front);
+    return moved;
+}
+
+
+/**
+ @brief Execute one control command
+
+ ## Execute one control command
+
+ ### Arguments
+ - `string request` - Command, eg. `threads 8`
+
+ ### Return value
+ JSON reply, with `"ok"` set to whether the command succeeded
+
+ ### Notes
+ Commands:
+ - `status` - Threads, flags, queues, runs in progress (and their completion, see `campaignProgress`), events per second, ETA, and stages
+ - `threads <n>` - Set the number of simulation threads. Jobs already running above the new limit are not stopped
+ - `pause` - Stop starting new jobs, letting the running ones finish. `resume` starts them again
+ - `suspend` - Stop the running jobs as well (like SIGUSR1). `resume` continues them
+ - `drain` - Stop starting new jobs, and exit once the running ones are done
+ - `cancel` - Kill the running jobs and exit (like SIGTERM)
+ - `front run <n>...` - Move runs to the front of the queue
+ - `front geometry <n>...` - Move the check of geometry variants, and their queued runs, to the front of the queues
+*/
+string engine::controlCommand(string request){
+    stringstream ss(request);
+    string command; ss >> command;
+    if(command=="threads"){
+        int threads = 0;
+        if(!(ss >> threads) || threads<1) return "{\"ok\":false,\"error\":\"usage: threads <n>, with n at least 1\"}";
+        maxThreads = threads;
+        quickSlack("Using "+to_string(threads)+" threads.",2);
+        return "{\"ok\":true,\"threads\":"+to_string(threads)+"}";
+    }
+    if(command=="pause"){
+        holding = 1;
+        return "{\"ok\":true}";
+    }
+    if(command=="suspend"){
+        paused = 1;
+        return "{\"ok\":true}";
+    }
+    if(command=="resume"){
+        holding = paused = 0;
+        return "{\"ok\":true}";
+    }
+    if(command=="drain"){
+        draining = 1;
+        quickSlack("Draining: no new job will be started.",2);
+        return "{\"ok\":true}";
+    }
+    if(command=="cancel"){
+        interrupted = 1;
+        return "{\"ok\":true}";
+    }
+    if(command=="front"){
+        string kind; ss >> kind;
+        set<int> selected;
+        for(int n;ss >> n;) selected.insert(n);
+        if((kind!="run" && kind!="geometry") || selected.empty()) return "{\"ok\":false,\"error\":\"usage: front run|geometry <n>...\"}";
+        int checks = 0, runs = 0;
+        lock_guard<mutex> lock(queueLock);
+        if(kind=="run") runs = queueFront(runQueue,[&](int run){ return selected.count(run)>0; });
+        else {
+            checks = queueFront(checkQueue,[&](int geometry){ return selected.count(geometry)>0; });
+            // Runs are numbered with the geometry varying fastest (see writeSources)
+            if(reprocessCatalog.empty() && geometryCount>0) runs = queueFront(runQueue,[&](int run){ return selected.count(run%geometryCount)>0; });
+        }
+        return "{\"ok\":true,\"checks\":"+to_string(checks)+",\"runs\":"+to_string(runs)+"}";
+    }
+    if(command=="status"){
+        stringstream reply;
+        reply << "{\"ok\":true,\"threads\":{\"running\":" << currentThreadCount << ",\"max\":" << maxThreads << "}"
+              << ",\"paused\":" << (paused?"true":"false") << ",\"holding\":" << (holding?"true":"false")
+              << ",\"draining\":" << (draining?"true":"false") << ",\"interrupted\":" << (interrupted?"true":"false")
+              << ",\"geometryDone\":" << (geometryDone?"true":"false");
+        reply << ",\"geometries\":{\"valid\":" << statusBar[1] << ",\"total\":" << statusBar[2] << "}"
+              << ",\"runs\":{\"done\":" << statusBar[7] << ",\"total\":" << statusBar[8] << "}";
+        if(deadlineTime>0) reply << ",\"deadline\":{\"left\":" << max(0LL,deadlineTime-(long long)time(NULL)) << ",\"fraction\":" << deadlineLast << "}";
+        queueLock.lock();
+        reply << ",\"queues\":{\"checks\":" << checkQueue.size() << ",\"runs\":" << runQueue.size() << ",\"next\":[";
+        for(size_t i=0;i<runQueue.size() && i<10;i++) reply << (i?",":"") << runQueue[i].second;
+        reply << "]}";
+        queueLock.unlock();
+        reply << ",\"running\":[";
+        inflightLock.lock();
+        bool first = 1;
+        for(auto& run:runsInFlight){ reply << (first?"":",") << run.first; first = 0; }
+        inflightLock.unlock();
+        reply << "]";
+        double runs;
+        long long events;
+        vector<pair<int,double>> completion;
+        campaignProgress(runs,events,&completion);
+        reply << ",\"progress\":{\"events\":" << events << ",\"eventsPerSecond\":" << eventRate(events) << ",\"eta\":" << (long long)campaignEta(runs) << ",\"completion\":{";
+        for(size_t i=0;i<completion.size();i++) reply << (i?",":"") << "\"" << completion[i].first << "\":" << completion[i].second;
+        reply << "}},\"stages\":[";
+        stageLock.lock();
+        for(size_t i=0;i<stages.size();i++) reply << (i?",":"") << "{\"name\":" << jsonQuote(stages[i].name) << ",\"queued\":" << stages[i].queue.size() << ",\"running\":" << stages[i].running << ",\"done\":" << stages[i].done << ",\"failed\":" << stages[i].failed << "}";
+        stageLock.unlock();
+        reply << "]}";
+        return reply.str();
+    }
+    return "{\"ok\":false,\"error\":"+jsonQuote("unknown command \""+command+"\"")+"}";
+}
+
+
+/**
+ @brief Print the size of a campaign without running it
+
+ ## Print the size of a campaign without running it
+
+ ### Arguments
+ - `YAML::Node config` - Campaign configuration
+ - `string history` - Catalog of a previous campaign to base the estimates on (ignored if it does not exist)
+
+ ### Return value
+ Returns 0 on success, the return code of the failed parsing stage otherwise
+
+ ### Notes
+ Only parses the configuration: no file is read other than the catalog (opened as immutable, so it should not belong to a running campaign), and none is written. Prints the number of geometry variants and runs, the options of every parameter, and, if the catalog has records of successful runs, the expected .sim.gz and .tra.gz volume and wall time at `maxThreads`. Per run estimates are scaled by the number of triggers (or events, or time) of both campaigns, if they use the same keyword.
+*/
+int engine::planCampaign(YAML::Node config, string history){
+    if(config["stages"]){
+        int status = stagesSetup(config["stages"]);
+        if(status) return status;
+    }
+    auto printStages = [this](double runs){
+        for(auto& stage:stages) cout << "  stage " << stage.name << ": " << (stage.reduce?string("1 job (reduce)"):to_string((long long)runs)+" jobs at most") << "\n";
+    };
+    if(config["reprocess"]){
+        int status = reprocessSetup(config["reprocess"]);
+        if(status) return status;
+        cout << "Plan for \""+(settings.empty()?directory:settings)+"\":\nRuns to reprocess (revan only): " << reprocessRuns.size() << endl;
+        printStages(reprocessRuns.size());
+        return 0;
+    }
+    geomegaParameters geoParameters;
+    if(config["cosima"]){
+        if(!config["cosima"]["filename"]){
+            quickSlack("PLAN: Cosima section has no filename. Exiting.");
+            return 3;
+        }
+        int status = cosimaSetup(config["cosima"],0);
+        if(status) return status;
+    }
+    if(config["geomega"]){
+        int status = geomegaParse(config["geomega"],geoParameters);
+        if(status) return status;
+    }
+
+    // Count runs, without building any geometry or source
+    double geometries = 1, sources = config["cosima"]?1:0;
+    cout << "Plan for \""+(settings.empty()?directory:settings)+"\":\n";
+    for(auto& p:geometryParameters){
+        geometries *= p.options.size();
+        cout << "  geomega " << p.name << " (" << p.file << ":" << p.line << "): " << p.options.size() << " options\n";
+    }
+    for(auto& p:sourceParameters){
+        sources *= p.options.size();
+        cout << "  cosima " << p.name << ": " << p.options.size() << " options\n";
+    }
+    double runs = geometries*sources;
+    cout << fixed << setprecision(0);
+    cout << "Geometry variants: " << geometries << "\nSource variants: " << sources << "\nRuns: " << runs << " (before geometry checks)\n";
+    printStages(runs);
+
+    // Estimate from a previous campaign
+    sqlite3* previous = NULL;
+    if(history.empty() || !fileExists(history) || sqlite3_open_v2(("file:"+history+"?immutable=1").c_str(),&previous,SQLITE_OPEN_READONLY|SQLITE_OPEN_URI,NULL)!=SQLITE_OK){
+        sqlite3_close(previous);
+        cout << "No previous catalog to estimate storage and wall time from (see --history)." << endl;
+        return 0;
+    }
+    sqlite3_stmt* statement = NULL;
+    double done = 0, runTime = 0, simBytes = -1, traBytes = -1;
+    if(sqlite3_prepare_v2(previous,"SELECT count(*),avg(finished-started),avg(sim_bytes),avg(tra_bytes) FROM runs WHERE status='done'",-1,&statement,NULL)==SQLITE_OK && sqlite3_step(statement)==SQLITE_ROW){
+        done = sqlite3_column_double(statement,0);
+        runTime = sqlite3_column_double(statement,1);
+        if(sqlite3_column_type(statement,2)!=SQLITE_NULL) simBytes = sqlite3_column_double(statement,2);
+        if(sqlite3_column_type(statement,3)!=SQLITE_NULL) traBytes = sqlite3_column_double(statement,3);
+    }
+    sqlite3_finalize(statement);
+    string timing;
+    if(sqlite3_prepare_v2(previous,"SELECT value FROM campaign WHERE key='timing'",-1,&statement,NULL)==SQLITE_OK && sqlite3_step(statement)==SQLITE_ROW) timing = (const char*)sqlite3_column_text(statement,0);
+    sqlite3_finalize(statement);
+    sqlite3_close(previous);
+    if(done==0){
+        cout << "No successful runs in \""+history+"\" to estimate storage and wall time from." << endl;
+        return 0;
+    }
+
+    // Scale by the length of the runs
+    double scale = 1;
+    stringstream previousTiming(timing);
+    string keyword; double value = 0;
+    if(previousTiming >> keyword >> value && keyword==sourceTiming[0] && value>0) scale = atof(sourceTiming[1].c_str())/value;
+    cout << "Estimates from " << done << " runs in \""+history+"\"";
+    if(scale!=1) cout << setprecision(3) << defaultfloat << " (scaled by " << scale << " for the number of "+sourceTiming[0]+")" << fixed << setprecision(0);
+    cout << ":\n";
+    if(simBytes>=0) cout << "  .sim.gz: " << beautify_bytes(simBytes*scale) << " per run, " << beautify_bytes(simBytes*scale*runs) << " in total (kept according to the \""+simRetention+"\" retention policy)\n";
+    else cout << "  .sim.gz: no previous sizes\n";
+    if(traBytes>=0) cout << "  .tra.gz: " << beautify_bytes(traBytes*scale) << " per run, " << beautify_bytes(traBytes*scale*runs) << " in total\n";
+    else cout << "  .tra.gz: no previous sizes\n";
+    double threads = min((double)maxThreads,runs);
+    cout << "  Wall time: " << beautify_duration(chrono::seconds((long long)(runTime*scale))) << " per run, " << beautify_duration(chrono::seconds((long long)((threads>0)?runTime*scale*runs/threads:0))) << " in total with " << threads << " threads (not counting geometry checks or retries)" << endl;
+    return 0;
+}
+
+
+/**
+ @brief Report a finished run
+
+ ## Report a finished run
+
+ ### Arguments
+ - `int runNumber` - Run number
+ - `bool failed` - Whether every attempt failed
+ - `int attempts` - Number of attempts
+ - `string tra` - Revan output (empty if there is none)
+
+ ### Notes
+ Called from the thread of the run, as soon as it is recorded in the catalog. The run is added to `finished`, and given to `runCallback`, one run at a time.
+*/
+void engine::reportRun(int runNumber, bool failed, int attempts, string tra){
+    run r;
+    auto previous = reprocessed.find(runNumber);
+    if(previous!=reprocessed.end()) r = previous->second;
+    else {
+        // Runs are numbered with the geometry varying fastest (see writeSources)
+        vector<pair<string,string>> values;
+        if(geomega){
+            r.geometry = runNumber%geometryCount;
+            parameterValues(geometryParameters,r.geometry,0,values);
+        }
+        parameterValues(sourceParameters,runNumber/geometryCount,1,values);
+        r.parameters.insert(values.begin(),values.end());
+    }
+    r.id = runNumber;
+    r.status = failed?"failed":"done";
+    r.attempts = attempts;
+    r.tra = tra.empty()?tra:absolutePath(tra);
+    lock_guard<mutex> lock(reportLock);
+    finished.push_back(r);
+    if(runCallback) runCallback(r);
+}
+
+
+/**
+ @brief Create a campaign engine
+
+ ## Create a campaign engine
+
+ ### Arguments
+ - `string directory` - Campaign directory (absolute path)
+*/
+engine::engine(string directory) : directory(directory), config(YAML::NodeType::Map) {
+    for(int i=0;i<9;i++) statusBar[i]=0;
+}
+
+
+/**
+ @brief Move the calling thread into the campaign directory
+
+ ## Move the calling thread into the campaign directory
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Creates the directory if needed. The thread stops sharing its working directory with the rest of the process (`unshare(CLONE_FS)`), so changing it does not affect the program running the campaign, or other campaigns. Every thread it starts, and every command they run, starts in the campaign directory.
+*/
+bool engine::enter(){
+    if(makeDirectory(directory)) return 1;
+    return unshare(CLONE_FS)!=0 || chdir(directory.c_str())!=0;
+}
+
+
+/**
+ @brief Read the general settings of the campaign from its configuration
+
+ ## Read the general settings of the campaign from its configuration
+
+ ### Return value
+ Returns 0 on success, 1 otherwise
+
+ ### Notes
+ Must be called from the campaign directory (see `enter`), since relative paths are relative to it. The cosima, geomega, reprocess and stages sections are parsed by `execute` (or `planCampaign`).
+*/
+int engine::setup(){
+    if(config["address"]) address = config["address"].as<string>();
+    if(config["token"]) token = config["token"].as<string>();
+    if(config["channel"]) channel = config["channel"].as<string>();
+    if(config["keepAll"]) keepAll = config["keepAll"].as<bool>();
+    if(config["stream"]) stream = config["stream"].as<bool>() && !config["reprocess"];
+    if(config["warmGeometry"]) warmGeometries = config["warmGeometry"].as<bool>();
+    if(config["runDirectories"]) runDirectories = config["runDirectories"].as<bool>();
+    if(config["scratch"]) scratch = config["scratch"].as<string>();
+    if(config["slackVerbosity"]) slackVerbosity = config["slackVerbosity"].as<int>();
+    if(config["cosimaVerbosity"]) cosimaVerbosity = config["cosimaVerbosity"].as<int>();
+    if(config["revanSettings"]) revanSettings = config["revanSettings"].as<string>();
+    // Revan runs in the directory of each run, so relative settings files need an absolute path (`~` is expanded by the shell)
+    if(!revanSettings.empty() && revanSettings[0]!='~') revanSettings = absolutePath(revanSettings);
+    if(config["maxThreads"]) maxThreads = config["maxThreads"].as<int>();
+    if(config["controlSocket"]) controlSocket = config["controlSocket"].as<string>();
+    if(threads>0) maxThreads = threads;
+    masterSeed = config["seed"]?config["seed"].as<uint64_t>():random_seed<uint64_t>();
+    if(config["cleanupThreads"]) cleanupThreads = config["cleanupThreads"].as<int>();
+    if(config["retention"]){
+        if(config["retention"]["sim"]) simRetention = config["retention"]["sim"].as<string>();
+        if(config["retention"]["keepFirst"]) keepFirst = config["retention"]["keepFirst"].as<int>();
+        if(config["retention"]["pressureMB"]) pressureMB = config["retention"]["pressureMB"].as<double>();
+    }
+    if(config["placement"]){
+        placement = 1;
+        if(config["placement"]["coresPerJob"]) coresPerJob = config["placement"]["coresPerJob"].as<int>();
+        if(config["placement"]["helperCores"]) helperCores = config["placement"]["helperCores"].as<int>();
+        if(config["placement"]["bindMemory"]) bindMemory = config["placement"]["bindMemory"].as<bool>();
+    }
+    if(config["retries"]) retries = config["retries"].as<int>();
+    if(config["timeouts"]){
+        timeouts = 1;
+        if(config["timeouts"]["percentile"]) timeoutPercentile = config["timeouts"]["percentile"].as<double>();
+        if(config["timeouts"]["factor"]) timeoutFactor = config["timeouts"]["factor"].as<double>();
+        if(config["timeouts"]["minimum"]) timeoutMinimum = config["timeouts"]["minimum"].as<double>();
+        if(config["timeouts"]["minSamples"]) timeoutSamples = config["timeouts"]["minSamples"].as<int>();
+    }
+    if(config["speculation"]){
+        speculation = 1;
+        if(config["speculation"]["factor"]) speculationFactor = config["speculation"]["factor"].as<double>();
+        if(config["speculation"]["copies"]) speculationCopies = config["speculation"]["copies"].as<int>();
+        if(config["speculation"]["minSamples"]) speculationSamples = config["speculation"]["minSamples"].as<int>();
+    }
+    if(config["summary"]){
+        summarise = 1;
+        if(config["summary"]["filename"]) summaryFile = config["summary"]["filename"].as<string>();
+        if(config["summary"]["bins"]) summaryBins = config["summary"]["bins"].as<int>();
+        if(config["summary"]["minimum"]) summaryMinimum = config["summary"]["minimum"].as<double>();
+        if(config["summary"]["maximum"]) summaryMaximum = config["summary"]["maximum"].as<double>();
+        if(config["summary"]["logarithmic"]) summaryLogarithmic = config["summary"]["logarithmic"].as<bool>();
+        if(summaryBins<1 || summaryMaximum<=summaryMinimum || (summaryLogarithmic && summaryMinimum<=0)){
+            quickSlack("MAIN: Invalid summary spectrum (bins must be positive, maximum above minimum, and minimum positive if logarithmic). Exiting.");
+            return 1;
+        }
+    }
+    if(config["deadline"]){
+        if(!config["deadline"]["hours"]){
+            quickSlack("MAIN: The deadline needs a number of hours. Exiting.");
+            return 1;
+        }
+        deadlineTime = time(NULL)+(long long)(config["deadline"]["hours"].as<double>()*3600);
+        if(config["deadline"]["coarseToFine"]) deadlineOrder = config["deadline"]["coarseToFine"].as<bool>();
+        if(config["deadline"]["reduce"]) deadlineReduce = config["deadline"]["reduce"].as<bool>();
+        if(config["deadline"]["minimumFraction"]) deadlineMinimum = config["deadline"]["minimumFraction"].as<double>();
+        if(deadlineMinimum<=0 || deadlineMinimum>1){
+            quickSlack("MAIN: The minimum fraction of the deadline must be above 0, and at most 1. Exiting.");
+            return 1;
+        }
+    }
+    if(keepAll) simRetention = "all";
+    if(simRetention!="none" && simRetention!="all" && simRetention!="failed" && simRetention!="first" && simRetention!="pressure"){
+        quickSlack("MAIN: Unknown retention policy \""+simRetention+"\". Exiting.");
+        return 1;
+    }
+    geomega = config["geomega"] && !config["reprocess"];
+
+    // checkGeometry is installed next to autoMEGA, which may not be the program running the campaign
+    if(config["checkGeometry"]) checkGeometry = absolutePath(config["checkGeometry"].as<string>());
+    else {
+        char result[PATH_MAX];
+        ssize_t count = readlink("/proc/self/exe",result,sizeof(result)-1);
+        if(count>=0) result[count] = 0;
+        string installed = (count>=0)?string(dirname(result))+"/checkGeometry":"";
+        checkGeometry = (!installed.empty() && fileExists(installed))?installed:"checkGeometry";
+    }
+    return 0;
+}
+
+
+/**
+ @brief Run the campaign
+
+ ## Run the campaign
+
+ ### Return value
+ Returns 0 if the campaign completed, 1 if it could not start, 2 if the geomega stage failed, 3 if another stage could not be set up (or the directory was not to be used), and 4 if it was cancelled or drained
+
+ ### Notes
+ Must be called after `setup`, from the campaign directory. Starts the background threads, sets up every stage, and dispatches geometry checks, simulations and stage jobs to at most `maxThreads` threads until nothing is left to run. Every thread is joined before it returns.
+*/
+int engine::execute(){
+    auto start = chrono::steady_clock::now();
+
+    // Reprocessing starts by replacing catalog.db (and maybe cleaning the directory), so it cannot run where the previous campaign is kept
+    if(config["reprocess"] && config["reprocess"]["catalog"]){
+        string previous = absolutePath(config["reprocess"]["catalog"].as<string>());
+        char resolved[PATH_MAX], current[PATH_MAX];
+        string directory = previous.substr(0,previous.rfind('/'));
+        if(realpath(directory.c_str(),resolved)!=NULL && realpath(".",current)!=NULL){
+            string inside = string(resolved)+"/", here = string(current)+"/";
+            if(inside.compare(0,here.size(),here)==0){
+                quickSlack("MAIN: The catalog to reprocess (\""+previous+"\") is in this directory, which reprocessing would overwrite. Run it from another directory. Exiting.");
+                return 1;
+            }
+        }
+    }
+
+    // Build core sets from the CPU topology
+    if(placement){
+        if(placementSetup(coresPerJob,helperCores)) return 1;
+        if(!helperCPUs.empty() && system("command -v taskset > /dev/null 2>&1")){
+            quickSlack("MAIN: taskset not found. Helper processes will not be pinned.",1);
+            helperCPUs = "";
+        }
+    }
+
+    // Scratch directory of this campaign
+    if(!scratch.empty()){
+        string pattern = scratch+"/autoMEGA.XXXXXX";
+        vector<char> name(pattern.begin(),pattern.end());
+        name.push_back(0);
+        if(makeDirectory(scratch) || mkdtemp(name.data())==NULL){
+            quickSlack("MAIN: Could not create a directory in \""+scratch+"\". Exiting.");
+            return 1;
+        }
+        scratchRun = name.data();
+    }
+
+    // Start cleanup threads. They exit once exitFlag is set and nothing is left to delete, and are joined on every exit path.
+    vector<thread> cleanupWorkers;
+    for(int i=0;i<cleanupThreads;i++) cleanupWorkers.push_back(thread(&engine::cleanupWorker,this));
+
+    // Check directory
+    if(directoryEmpty(".")){
+        exitFlag=1;
+        for(auto& worker:cleanupWorkers) worker.join();
+        if(!scratchRun.empty()) rmdir(scratchRun.c_str());
+        return 3;
+    }
+
+    // Create threadpool
+    vector<thread> threadpool;
+    if(!quiet){
+        if(placement){
+            cout << "Pinning jobs to "+to_string(placementSlots.size())+" core sets"+(bindMemory?" (memory bound to their NUMA node)":"")+":\n";
+            for(size_t i=0;i<placementSlots.size();i++){
+                cout << "  " << i << ": node " << placementSlots[i].node << ", CPUs ";
+                for(size_t j=0;j<placementSlots[i].cpus.size();j++) cout << (j?",":"") << placementSlots[i].cpus[j];
+                cout << "\n";
+            }
+            cout << "  helpers: " << (helperCPUs.empty()?string("not pinned"):"CPUs "+helperCPUs) << "\n";
+        }
+        cout << "Using "+to_string(maxThreads)+" threads.\nTo control (eg. status, threads <n>, pause, resume, drain):\nautoMEGA ctl --socket "+absolutePath(controlSocket)+" status\n" << endl;
+    }
+
+    // Start watchdog thread(s)
+    thread watchdog0(&engine::storageWatchdog,this,2000);
+
+    // Start status thread
+    thread statusThread(&engine::handleStatus,this);
+
+    // Cosima parsing stage
+    quickSlack("Starting Cosima parsing stage",3);
+    geomegaParameters geoParameters;
+    if((config["reprocess"]?reprocessSetup(config["reprocess"])!=0:((config["cosima"] && cosimaSetup(config["cosima"])!=0) || (config["geomega"] && geomegaParse(config["geomega"],geoParameters)!=0))) || (config["stages"] && stagesSetup(config["stages"])!=0)){
+        // Close threads
+        exitFlag=1;
+        watchdog0.join();
+        statusThread.join();
+        for(auto& worker:cleanupWorkers) worker.join();
+        if(!scratchRun.empty()) rmdir(scratchRun.c_str());
+        return 3;
+    }
+    if(reprocessCatalog.empty()){
+        statusBar[2]=geometryCount.load();
+        statusBar[5]=statusBar[8]=geometryCount*sourceTemplates.size();
+    }
+
+    // Create catalog, and start its writer
+    if(catalogOpen("catalog.db") || (!reprocessCatalog.empty() && reprocessQueue(config["reprocess"]))){
+        // Close threads
+        exitFlag=1;
+        watchdog0.join();
+        statusThread.join();
+        for(auto& worker:cleanupWorkers) worker.join();
+        if(!scratchRun.empty()) rmdir(scratchRun.c_str());
+        return 3;
+    }
+    thread catalogThread(&engine::catalogWriter,this);
+    if(deadlineTime>0) catalogPost("INSERT INTO campaign VALUES ('deadline',"+to_string(deadlineTime)+")");
+
+    // Start retention watchdog
+    thread retentionThread;
+    if(simRetention=="pressure") retentionThread = thread(&engine::retentionWatchdog,this);
+
+    // Geomega stage, streamed into the checks and simulations below
+    quickSlack("Starting Geomega stage.",3);
+    thread geometryThread;
+    if(!reprocessCatalog.empty()) geometryDone=1;
+    else if(config["geomega"]) geometryThread = thread([this,&geoParameters](){ geometryStatus=geomegaSetup(geoParameters); geometryDone=1; });
+    else {
+        writeSources("",0);
+        geometryDone=1;
+    }
+
+    // Dispatch geometry checks and simulations as they become available. Checks go first, since they unlock more runs.
+    quickSlack("Starting simulations",3);
+    thread controlThread([this](){
+        if(serve(controlSocket,[this](string request){ return controlCommand(request); },exitFlag)) quickSlack("CONTROL: Could not listen on \""+controlSocket+"\". Runtime control is disabled.",1);
+    });
+    int stageIndex, stageRun;
+    while(1){
+        if(deadlineTime>0 && time(NULL)>=deadlineTime && !draining){
+            draining = 1;
+            quickSlack("Deadline reached. Draining: no new job will be started.",1);
+        }
+        bool launched = 0;
+        if(currentThreadCount<maxThreads && geometryStatus==0 && !paused && !holding && !draining && !interrupted){
+            queueLock.lock();
+            if(!checkQueue.empty()){
+                pair<string,int> geometry = checkQueue.front(); checkQueue.pop_front();
+                queueLock.unlock();
+                if(!test){
+                    currentThreadCount++;
+                    threadpool.push_back(thread(&engine::testGeometry,this,geometry.first,geometry.second));
+                } else {
+                    cout << (checkGeometry+" "+geometry.first) << endl;
+                    catalogPost("UPDATE geometries SET status='unchecked' WHERE geometry_id="+to_string(geometry.second));
+                    statusBar[1]++;
+                    writeSources(geometry.first,geometry.second);
+                }
+                launched = 1;
+            } else if((stageIndex=nextStageJob(stageRun))>=0){
+                // Stage jobs go before new runs, so results are finished as early as possible
+                queueLock.unlock();
+                currentThreadCount++;
+                stageJobsRunning++;
+                threadpool.push_back(thread(&engine::runStage,this,stageIndex,stageRun));
+                launched = 1;
+            } else if(!runQueue.empty()){
+                pair<string,int> run = runQueue.front(); runQueue.pop_front();
+                queueLock.unlock();
+                currentThreadCount++;
+                threadpool.push_back(thread(&engine::runSimulation,this,run.first,run.second));
+                launched = 1;
+            } else {
+                queueLock.unlock();
+                // Nothing is waiting, so start an extra copy of the slowest straggler on an idle thread
+                int copy = 0;
+                shared_ptr<runState> straggler;
+                if(speculation && geometryDone && !test) straggler = findStraggler(copy);
+                if(straggler){
+                    quickSlack("Starting copy "+to_string(copy)+" of straggling run "+to_string(straggler->run)+".",3);
+                    currentThreadCount++;
+                    threadpool.push_back(thread(&engine::speculateRun,this,straggler,copy));
+                    launched = 1;
+                } else if((stageIndex=nextReduceStage())>=0){
+                    currentThreadCount++;
+                    stageJobsRunning++;
+                    threadpool.push_back(thread(&engine::runStage,this,stageIndex,-1));
+                    launched = 1;
+                }
+            }
+        }
+        if(launched) continue;
+
+        // Done once every variant is written, nothing is running, and nothing is left to start (or once drained)
+        if(geometryDone && currentThreadCount==0){
+            lock_guard<mutex> lock(queueLock);
+            if(geometryStatus!=0 || interrupted || draining || (checkQueue.empty() && runQueue.empty() && stagesIdle())) break;
+        }
+        usleep(100000);
+    }
+    if(geometryThread.joinable()) geometryThread.join();
+
+    // Join simulation threads
+    for(size_t i=0;i<threadpool.size();i++) threadpool[i].join();
+    if(!scratchRun.empty()) rmdir(scratchRun.c_str());
+    cleanupWait();
+
+    // Flush catalog
+    catalogPost("INSERT INTO campaign VALUES ('finished',"+to_string(time(NULL))+")");
+    if(draining) catalogPost("INSERT INTO campaign VALUES ('drained',"+to_string(time(NULL))+")");
+    catalogDone=1;
+    catalogThread.join();
+
+    // Write the summary of the revan outputs, with the parameters of every run from the catalog, then close it
+    if(summarise && !test){
+        if(summaryWrite(summaryFile)) quickSlack("SUMMARY: Could not write \""+summaryFile+"\".",1);
+        else sqlite3_exec(catalog,("INSERT INTO campaign VALUES ('summary',"+sqlQuote(absolutePath(summaryFile))+")").c_str(),NULL,NULL,NULL);
+    }
+    sqlite3_close(catalog);
+
+    // Close threads
+    exitFlag=1;
+    watchdog0.join();
+    statusThread.join();
+    for(auto& worker:cleanupWorkers) worker.join();
+    controlThread.join();
+    if(retentionThread.joinable()) retentionThread.join();
+    if(!quiet) cout << endl;
+    if(geometryStatus!=0) return 2;
+
+    // End timer, print command duration
+    auto end = chrono::steady_clock::now();
+    if(interrupted){
+        quickSlack("Simulation interrupted. Elapsed time: "+beautify_duration(chrono::duration_cast<chrono::seconds>(end-start)));
+        return 4;
+    }
+    if(draining){
+        quickSlack("Simulation drained. Elapsed time: "+beautify_duration(chrono::duration_cast<chrono::seconds>(end-start)));
+        return 4;
+    }
+    quickSlack("Simulation complete. Elapsed time: "+beautify_duration(chrono::duration_cast<chrono::seconds>(end-start)));
+    if(!address.empty()) email(address,"Simulation Complete. Elapsed time: "+beautify_duration(chrono::duration_cast<chrono::seconds>(end-start)));
+    return 0;
+}
+
+
+/**
+ @brief Run the campaign, from start to end (threadable)
+
+ ## Run the campaign, from start to end
+
+ ### Notes
+ Runs in `worker`, from `submit`. Sets `exitCode` (see `execute`), then calls `doneCallback`. Invalid values in the settings (eg. text where a number is expected) fail the campaign with return code 1.
+*/
+void engine::work(){
+    int code = 1;
+    if(enter()) quickSlack("MAIN: Could not enter \""+directory+"\". Exiting.");
+    else {
+        try {
+            code = setup();
+        } catch(const YAML::Exception& error){
+            quickSlack("MAIN: Invalid settings: "+string(error.what())+". Exiting.");
+            code = 1;
+        }
+        if(code==0) code = execute();
+    }
+    exitCode = code;
+    if(doneCallback) doneCallback(code);
+}
+
+
+/**
+ @brief Element taking literal values
+
+ ## Element taking literal values
+
+ ### Arguments
+ - `vector<string> values` - Values of the element
+*/
+element literals(vector<string> values){
+    element e;
+    e.literals = values;
+    return e;
+}
+
+
+/**
+ @brief Element taking the values of a range
+
+ ## Element taking the values of a range
+
+ ### Arguments
+ - `double first` - First value
+ - `double last` - Last value (excluded)
+ - `double step` - Step between values
+*/
+element range(double first, double last, double step){
+    element e;
+    e.first = first;
+    e.last = last;
+    e.step = step;
+    e.range = true;
+    return e;
+}
+
+
+/**
+ @brief Send one request to a control socket
+
+ ## Send one request to a control socket
+
+ ### Arguments
+ - `string socket` - Path of the control socket (of a campaign, or of the daemon)
+ - `string request` - Request (eg. `status`)
+ - `string& reply` - Reply, a JSON object (return by reference)
+
+ ### Return value
+ Returns 0 on success, 1 if the socket could not be reached or did not reply
+*/
+bool request(string socket, string request, string& reply){
+    sockaddr_un address;
+    memset(&address,0,sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket.size()>=sizeof(address.sun_path)) return 1;
+    strncpy(address.sun_path,socket.c_str(),sizeof(address.sun_path)-1);
+    int server = ::socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+    if(server<0 || connect(server,(sockaddr*)&address,sizeof(address))!=0){
+        if(server>=0) close(server);
+        return 1;
+    }
+    request += "\n";
+    reply = "";
+    if(write(server,request.c_str(),request.size())==(ssize_t)request.size()){
+        char buffer[4096];
+        for(ssize_t count;(count=read(server,buffer,sizeof(buffer)))>0;) reply.append(buffer,count);
+    }
+    close(server);
+    return reply.empty();
+}
+
+
+/**
+ @brief Accept requests on a control socket
+
+ ## Accept requests on a control socket
+
+ ### Arguments
+ - `string socket` - Path of the socket to listen on
+ - `function<string(string)> handle` - Executes one request and returns its reply (eg. `campaign::control`)
+ - `const atomic<bool>& stop` - Flag to stop listening
+
+ ### Return value
+ Returns 0 once `stop` is set, or 1 if it could not listen
+
+ ### Notes
+ Each connection sends one request, terminated by a newline or by closing its end, and receives one line (see `request`). The socket is removed when it stops.
+*/
+bool serve(string socket, function<string(string)> handle, const atomic<bool>& stop){
+    sockaddr_un address;
+    memset(&address,0,sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket.size()>=sizeof(address.sun_path)) return 1;
+    strncpy(address.sun_path,socket.c_str(),sizeof(address.sun_path)-1);
+    int server = ::socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+    unlink(socket.c_str());
+    if(server<0 || ::bind(server,(sockaddr*)&address,sizeof(address))!=0 || listen(server,8)!=0){
+        if(server>=0) close(server);
+        return 1;
+    }
+    while(!stop){
+        pollfd waiting = {server,POLLIN,0};
+        if(poll(&waiting,1,200)<=0) continue;
+        int client = accept4(server,NULL,NULL,SOCK_CLOEXEC);
+        if(client<0) continue;
+        timeval timeout = {1,0};
+        setsockopt(client,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+        string request;
+        char buffer[256];
+        for(ssize_t count;request.find('\n')==string::npos && (count=read(client,buffer,sizeof(buffer)))>0;) request.append(buffer,count);
+        // The client may be gone already, which must not raise SIGPIPE in the program running the campaign
+        string reply = handle(request.substr(0,request.find('\n')))+"\n";
+        send(client,reply.c_str(),reply.size(),MSG_NOSIGNAL);
+        close(client);
+    }
+    close(server);
+    unlink(socket.c_str());
+    return 0;
+}
+
+
+/**
+ @brief Contents of a parameter, in the standard format of the settings file
+
+ ## Contents of a parameter, in the standard format of the settings file
+*/
+static YAML::Node contents(const vector<element>& elements){
+    YAML::Node node;
+    for(auto& e:elements){
+        YAML::Node item;
+        if(e.range){
+            item.push_back(e.first);
+            item.push_back(e.last);
+            item.push_back(e.step);
+        } else {
+            YAML::Node values;
+            for(auto& value:e.literals) values.push_back(value);
+            item.push_back(values);
+        }
+        node.push_back(item);
+    }
+    return node;
+}
+
+
+/**
+ @brief Create a campaign
+
+ ## Create a campaign
+
+ ### Arguments
+ - `string directory` - Campaign directory (created when the campaign is submitted, if it does not exist). Defaults to the current directory.
+
+ ### Notes
+ By default, files already in the directory are kept (see `existing`), and no status bar is printed (see `quiet`).
+*/
+campaign::campaign(string directory) : state(new engine(absolutePath(directory))) {
+    state->existingFiles = "skip";
+    state->quiet = 1;
+}
+
+
+/**
+ @brief Cancel the campaign if it still runs, and wait for it
+
+ ## Cancel the campaign if it still runs, and wait for it
+*/
+campaign::~campaign(){
+    if(running()) cancel();
+    wait();
+}
+
+
+/**
+ @brief Set the base geometry
+
+ ## Set the base geometry
+
+ ### Arguments
+ - `string filename` - Base .geo.setup file, relative to the current directory
+ - `bool overlay` - Whether to only write the modified files for each variant (see the `overlay` geomega setting)
+*/
+void campaign::geometry(string filename, bool overlay){
+    state->config["geomega"]["filename"] = absolutePath(filename);
+    state->config["geomega"]["overlay"] = overlay;
+}
+
+
+/**
+ @brief Add a geometry parameter
+
+ ## Add a geometry parameter
+
+ ### Notes
+ Requires a base geometry (see `geometry`). Unnamed parameters are named after their position.
+*/
+void campaign::vary(geometryParameter parameter){
+    if(parameter.name.empty()) parameter.name = to_string(state->config["geomega"]["parameters"].size());
+    state->config["geomega"]["parameters"][parameter.name]["filename"] = parameter.file;
+    state->config["geomega"]["parameters"][parameter.name]["lineNumber"] = parameter.line;
+    state->config["geomega"]["parameters"][parameter.name]["contents"] = contents(parameter.contents);
+}
+
+
+/**
+ @brief Set the base cosima source
+
+ ## Set the base cosima source
+
+ ### Arguments
+ - `string filename` - Base .source file, relative to the current directory
+ - `string timing` - "triggers", "events" or "time" (if empty, the base file is not modified)
+ - `string value` - Value of the timing keyword
+*/
+void campaign::source(string filename, string timing, string value){
+    state->config["cosima"]["filename"] = absolutePath(filename);
+    if(!timing.empty()) state->config["cosima"][timing] = YAML::Load(value);
+}
+
+
+/**
+ @brief Add a source parameter
+
+ ## Add a source parameter
+
+ ### Notes
+ Requires a base source (see `source`).
+*/
+void campaign::vary(sourceParameter parameter){
+    string key = to_string(state->config["cosima"]["parameters"].size());
+    state->config["cosima"]["parameters"][key]["source"] = parameter.source;
+    state->config["cosima"]["parameters"][key][parameter.keyword] = contents(parameter.contents);
+}
+
+
+/**
+ @brief Set any other setting of the campaign
+
+ ## Set any other setting of the campaign
+
+ ### Arguments
+ - `string key` - Setting, with dots separating nested keys (eg. `maxThreads`, `retention.sim` or `summary.bins`)
+ - `string value` - Value, as it would be written in the settings file. Relative paths are relative to the campaign directory
+*/
+void campaign::setting(string key, string value){
+    vector<string> keys;
+    stringstream ss(key);
+    for(string k;getline(ss,k,'.');) keys.push_back(k);
+    if(keys.empty()) return;
+    function<void(YAML::Node,size_t)> assign = [&](YAML::Node node, size_t i){
+        if(i+1==keys.size()) node[keys[i]] = YAML::Load(value);
+        else assign(node[keys[i]],i+1);
+    };
+    assign(state->config,0);
+}
+
+
+/**
+ @brief Replace the whole configuration of the campaign
+
+ ## Replace the whole configuration of the campaign
+
+ ### Arguments
+ - `const YAML::Node& config` - Configuration, in the format of the settings file (see `autoMEGA`)
+ - `string settings` - Settings file it was read from, recorded in the catalog and kept when the directory is cleaned (optional)
+
+ ### Notes
+ Used by autoMEGA to run its settings file. Relative paths in the configuration are relative to the campaign directory.
+*/
+void campaign::configure(const YAML::Node& config, string settings){
+    state->config = YAML::Clone(config);
+    state->settings = settings.empty()?settings:absolutePath(settings);
+}
+
+
+/**
+ @brief Set what to do with files already in the campaign directory
+
+ ## Set what to do with files already in the campaign directory
+
+ ### Arguments
+ - `string policy` - "clean" (delete them, except the settings file), "skip" (keep them, the default), "exit" (do not run the campaign, which returns 3), or "" to ask on the standard input
+*/
+void campaign::existing(string policy){
+    state->existingFiles = policy;
+}
+
+
+/**
+ @brief Set whether to print the status bar
+
+ ## Set whether to print the status bar
+
+ ### Notes
+ Campaigns are quiet by default. Messages are printed either way (see `onMessage`).
+*/
+void campaign::quiet(bool quiet){
+    state->quiet = quiet;
+}
+
+
+/**
+ @brief Set the test level
+
+ ## Set the test level
+
+ ### Notes
+ In test mode (1), commands are printed instead of being run (see `autoMEGA --test`), and no run is reported.
+*/
+void campaign::test(int level){
+    state->test = level;
+}
+
+
+/**
+ @brief Set the function called for every finished run
+
+ ## Set the function called for every finished run
+
+ ### Notes
+ Called from the thread of the run, as soon as it is done (or failed), and never for two runs at the same time. The run does not free its thread until it returns, so it should return quickly.
+*/
+void campaign::onRun(function<void(const run&)> callback){
+    state->runCallback = callback;
+}
+
+
+/**
+ @brief Set the function called once the campaign is done
+
+ ## Set the function called once the campaign is done
+
+ ### Notes
+ Called from the thread of the campaign, with its return code (0 if it completed, 4 if it was cancelled or drained, see `autoMEGA`), after every run was reported.
+*/
+void campaign::onDone(function<void(int)> callback){
+    state->doneCallback = callback;
+}
+
+
+/**
+ @brief Set the function called for every message of the campaign
+
+ ## Set the function called for every message of the campaign
+
+ ### Notes
+ Messages (progress, warnings and errors) are printed to stderr if it is not set. Called from any thread of the campaign.
+*/
+void campaign::onMessage(function<void(const string&)> callback){
+    state->messageCallback = callback;
+}
+
+
+/**
+ @brief Start the campaign
+
+ ## Start the campaign
+
+ ### Arguments
+ - `int threads` - Threads to use (if 0, the `maxThreads` setting, or the number of threads of the node)
+
+ ### Return value
+ Returns 0 on success, 1 if it was already submitted
+
+ ### Notes
+ Returns immediately: the campaign runs in its own threads, in its directory, and reports through the callbacks. A campaign can only be submitted once.
+*/
+bool campaign::submit(int threads){
+    if(state->started) return 1;
+    state->started = 1;
+    state->threads = threads;
+    state->worker = thread(&engine::work,state.get());
+    return 0;
+}
+
+
+/**
+ @brief Print the size of the campaign without running it
+
+ ## Print the size of the campaign without running it
+
+ ### Arguments
+ - `string history` - Catalog of a previous campaign to base the estimates on (relative to the current directory)
+
+ ### Return value
+ Returns 0 on success, the return code of the failed parsing stage otherwise (see `autoMEGA --plan`)
+*/
+int campaign::plan(string history){
+    if(state->started) return 1;
+    history = absolutePath(history);
+    int code = 1;
+    engine& e = *state;
+    thread planner([&](){
+        if(e.enter()) return;
+        try {
+            code = e.setup();
+            if(code==0) code = e.planCampaign(e.config,history);
+        } catch(const YAML::Exception& error){
+            e.quickSlack("MAIN: Invalid settings: "+string(error.what())+". Exiting.");
+            code = 1;
+        }
+    });
+    planner.join();
+    return code;
+}
+
+
+/**
+ @brief Execute a control command
+
+ ## Execute a control command
+
+ ### Arguments
+ - `string request` - Command (see `autoMEGA ctl`), eg. `status`, `threads 8`, `pause`, `resume`, `front run 12`
+
+ ### Return value
+ Returns the reply, a JSON object
+
+ ### Notes
+ Also works before the campaign is submitted, eg. `pause` to submit it held.
+*/
+string campaign::control(string request){
+    return state->controlCommand(request);
+}
+
+
+/**
+ @brief Cancel the campaign
+
+ ## Cancel the campaign
+
+ ### Arguments
+ - `bool drain` - Whether to let the running jobs finish (otherwise they are killed)
+
+ ### Return value
+ Returns 0 on success, 1 if the campaign is not running
+
+ ### Notes
+ Returns immediately. The campaign returns 4 (see `wait` and `onDone`).
+*/
+bool campaign::cancel(bool drain){
+    if(!running()) return 1;
+    state->controlCommand(drain?"drain":"cancel");
+    return 0;
+}
+
+
+/**
+ @brief Wait for the campaign to be done
+
+ ## Wait for the campaign to be done
+
+ ### Return value
+ Returns the return code of the campaign (-1 if it was never submitted)
+*/
+int campaign::wait(){
+    if(state->worker.joinable() && state->worker.get_id()!=this_thread::get_id()) state->worker.join();
+    return state->exitCode;
+}
+
+
+/**
+ @brief Whether the campaign was submitted and is not done yet
+
+ ## Whether the campaign was submitted and is not done yet
+*/
+bool campaign::running(){
+    return state->started && state->exitCode==-1;
+}
+
+
+/**
+ @brief Runs of the campaign finished so far
+
+ ## Runs of the campaign finished so far
+*/
+vector<run> campaign::runs(){
+    lock_guard<mutex> lock(state->reportLock);
+    return state->finished;
+}
+
+}
@@ -0,0 +1,162 @@
+/**
+    libautomega
+    Runs autoMEGA campaigns in-process: build a parameter space, submit it, and get every run as soon as it is done.
+    The autoMEGA command line is a thin wrapper over it.
+
+    @author Connor Bray
+*/
+
+#ifndef LIBAUTOMEGA_H
+#define LIBAUTOMEGA_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+namespace YAML { class Node; }
+
+namespace automega {
+
+/**
+ @brief One element of a parameter, in the standard format
+
+ ## One element of a parameter, in the standard format
+
+ ### Notes
+ Either a list of literal values, or a numeric range (from `first`, by `step`, up to but excluding `last`). The options of a parameter are every combination of the values of its elements, separated by spaces. See `literals` and `range`.
+*/
+struct element {
+    /// Literal values (only used if `range` is false)
+    std::vector<std::string> literals;
+    /// First value, last value (excluded) and step of a range
+    double first = 0, last = 0, step = 0;
+    /// Bool set for ranges
+    bool range = false;
+};
+
+/// Element taking literal values
+element literals(std::vector<std::string> values);
+/// Element taking the values of a range
+element range(double first, double last, double step);
+
+/**
+ @brief Geometry parameter: a line of a geometry file, replaced in every variant
+
+ ## Geometry parameter
+
+ ### Notes
+ An aggregate, so it can be written `{name, file, line, contents}`.
+*/
+struct geometryParameter {
+    /// Parameter name (catalog column `geo_<name>`)
+    std::string name;
+    /// File to modify, as referenced when included
+    std::string file;
+    /// Line to replace (one indexed)
+    int line;
+    /// Contents of the line
+    std::vector<element> contents;
+};
+
+/**
+ @brief Source parameter: a keyword of a cosima source
+
+ ## Source parameter
+*/
+struct sourceParameter {
+    /// Source to modify
+    std::string source;
+    /// Keyword to set: "beam", "spectrum", "flux", "polarization" or "particleType"
+    std::string keyword;
+    /// Everything after "<source>.<Keyword> "
+    std::vector<element> contents;
+};
+
+/**
+ @brief Finished run, as recorded in the catalog of its campaign
+
+ ## Finished run
+*/
+struct run {
+    /// Run and geometry numbers
+    int id = 0, geometry = -1;
+    /// "done" or "failed"
+    std::string status;
+    /// Number of attempts
+    int attempts = 0;
+    /// Revan output (absolute path, empty if there is none)
+    std::string tra;
+    /// Parameter values, by catalog column (eg. "src_Pos_Beam_1")
+    std::map<std::string,std::string> parameters;
+};
+
+/// Send one request to a control socket (of a campaign or of the daemon)
+bool request(std::string socket, std::string request, std::string& reply);
+/// Answer requests on a control socket until `stop` is set
+bool serve(std::string socket, std::function<std::string(std::string)> handle, const std::atomic<bool>& stop);
+
+/**
+ @brief Campaign driven from another program
+
+ ## Campaign driven from another program
+
+ ### Notes
+ The campaign runs in the calling process, on its own threads, in its own directory, with no state shared with other campaigns, so any number of them can run at the same time from one program. Every run is reported as soon as it is done, through the `onRun` callback, from the thread of the run. The `onDone` callback is called once the campaign is done. Callbacks run on threads of the campaign, whose working directory is the campaign directory, so they should return quickly. Paths given to `geometry` and `source` are relative to the current directory, other relative paths (in `setting` and `configure`) to the campaign directory.
+
+ Link with `-lautomega -lyaml-cpp -lsqlite3 -lz -pthread`.
+
+ Usage:
+ ```
+ automega::campaign c("sweep1");
+ c.source("run.source","triggers","10000");
+ c.vary(automega::sourceParameter{"Pos","beam",{automega::literals({"FarFieldPointSource"}),automega::range(0,90,10),automega::literals({"0"})}});
+ c.onRun([](const automega::run& r){ cout << r.id << " " << r.tra << endl; });
+ c.submit(8);
+ c.wait();
+ ```
+*/
+class campaign {
+public:
+    campaign(std::string directory=".");
+    ~campaign();
+    campaign(const campaign&) = delete;
+    campaign& operator=(const campaign&) = delete;
+
+    // Parameter space
+    void geometry(std::string filename, bool overlay=false);
+    void vary(geometryParameter parameter);
+    void source(std::string filename, std::string timing="", std::string value="");
+    void vary(sourceParameter parameter);
+    void setting(std::string key, std::string value);
+    void configure(const YAML::Node& config, std::string settings="");
+    void existing(std::string policy);
+    void quiet(bool quiet);
+    void test(int level);
+
+    // Callbacks
+    void onRun(std::function<void(const run&)> callback);
+    void onDone(std::function<void(int)> callback);
+    void onMessage(std::function<void(const std::string&)> callback);
+
+    // Control
+    bool submit(int threads=0);
+    int plan(std::string history);
+    std::string control(std::string request);
+    bool cancel(bool drain=false);
+    int wait();
+    bool running();
+    std::vector<run> runs();
+
+    /// State of a campaign (defined in libautomega.cpp)
+    struct engine;
+
+private:
+    std::unique_ptr<engine> state;
+};
+
+}
+
+#endif